@@ -22,6 +22,9 @@
 
 #include "application.h"
 
+#include "archivestream.h"
+#include "contentstore.h"
+#include "downloadmanager.h"
 #include "extractor.h"
 #include "filemanager.h"
 #include "networkaccessmanager.h"
@@ -42,6 +45,9 @@
 #include <QScopedPointer>
 #include <QSysInfo>
 #include <QThread>
+#include <QThreadPool>
+
+#include <QtConcurrent/QtConcurrent>
 
 using namespace Zeal;
 using namespace Zeal::Core;
@@ -62,6 +68,11 @@ Application::Application(QObject *parent) :
     m_settings = new Settings(this);
     m_networkManager = new NetworkAccessManager(this);
 
+    m_downloadThread = new QThread(this);
+    m_downloadManager = new DownloadManager();
+    m_downloadManager->moveToThread(m_downloadThread);
+    m_downloadThread->start();
+
     m_fileManager = new FileManager(this);
 
     // Extractor setup
@@ -72,9 +83,18 @@ Application::Application(QObject *parent) :
     connect(m_extractor, &Extractor::completed, this, &Application::extractionCompleted);
     connect(m_extractor, &Extractor::error, this, &Application::extractionError);
     connect(m_extractor, &Extractor::progress, this, &Application::extractionProgress);
+    m_streamExtractorPool = new QThreadPool(this);
 
     m_docsetRegistry = new Registry::DocsetRegistry();
 
+    if (m_settings->deduplicateDocsetFiles) {
+        // Files of docsets removed in previous sessions may be left in the store.
+        const QString storagePath = m_settings->docsetPath;
+        QtConcurrent::run([storagePath] {
+            ContentStore(storagePath).removeUnused();
+        });
+    }
+
     connect(m_settings, &Settings::updated, this, &Application::applySettings);
     applySettings();
 
@@ -92,9 +112,13 @@ Application::Application(QObject *parent) :
 
 Application::~Application()
 {
+    m_downloadThread->quit();
+    m_downloadThread->wait();
+    delete m_downloadManager;
     m_extractorThread->quit();
     m_extractorThread->wait();
     delete m_extractor;
+    m_streamExtractorPool->waitForDone();
     delete m_mainWindow;
     delete m_docsetRegistry;
 }
@@ -114,6 +138,11 @@ QNetworkAccessManager *Application::networkManager() const
     return m_networkManager;
 }
 
+DownloadManager *Application::downloadManager() const
+{
+    return m_downloadManager;
+}
+
 Settings *Application::settings() const
 {
     return m_settings;
@@ -146,18 +175,54 @@ void Application::extract(const QString &filePath, const QString &destination, c
                               Q_ARG(QString, root));
 }
 
+/*!
+  Starts extracting archive data written into \a stream in a worker thread. The future result is
+  an error message, or an empty string on success. Identical files are shared between docsets,
+  if enabled in settings.
+*/
+QFuture<QString> Application::extract(const QSharedPointer<ArchiveStream> &stream,
+                                      const QString &destination, const QString &root)
+{
+    const QString storagePath
+            = m_settings->deduplicateDocsetFiles ? m_settings->docsetPath : QString();
+    const bool packDocuments = m_settings->packDocsetDocuments;
+
+    return QtConcurrent::run(m_streamExtractorPool,
+                             [stream, destination, root, storagePath, packDocuments] {
+        return Extractor::extractStream(stream.data(), destination, root, storagePath,
+                                        packDocuments);
+    });
+}
+
 QNetworkReply *Application::download(const QUrl &url)
+{
+    return download(QNetworkRequest(url));
+}
+
+/*!
+  Sends GET \a request with Zeal user agent headers added. Unless \a networkManager is given, the
+  request is sent by the application network manager, which belongs to the GUI thread.
+*/
+QNetworkReply *Application::download(QNetworkRequest request,
+                                     QNetworkAccessManager *networkManager)
 {
     static const QString ua = userAgent();
     static const QByteArray uaJson = userAgentJson().toUtf8();
 
-    QNetworkRequest request(url);
+    const QUrl url = request.url();
     request.setHeader(QNetworkRequest::UserAgentHeader, ua);
 
     if (url.host().endsWith(QLatin1String(".zealdocs.org", Qt::CaseInsensitive)))
         request.setRawHeader("X-Zeal-User-Agent", uaJson);
 
-    return m_networkManager->get(request);
+#if QT_VERSION >= 0x050800
+    // Lets parallel downloads from the same host share a connection. Only offered over TLS,
+    // cleartext HTTP/2 upgrades are not reliably supported by mirrors.
+    if (url.scheme() == QLatin1String("https"))
+        request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+
+    return (networkManager ? networkManager : m_networkManager)->get(request);
 }
 
 /*!
@@ -201,6 +266,9 @@ void Application::applySettings()
 {
     m_docsetRegistry->setStoragePath(m_settings->docsetPath);
     m_docsetRegistry->setFuzzySearchEnabled(m_settings->fuzzySearchEnabled);
+    QMetaObject::invokeMethod(m_downloadManager, "setMaxConcurrentDownloads",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, m_settings->maxConcurrentDownloads));
 
     // HTTP Proxy Settings
     switch (m_settings->proxyType) {
@@ -223,6 +291,7 @@ void Application::applySettings()
 
         // Force NM to pick up changes.
         m_networkManager->clearAccessCache();
+        QMetaObject::invokeMethod(m_downloadManager, "clearAccessCache", Qt::QueuedConnection);
         break;
     }
     }
@@ -23,11 +23,15 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include <QFuture>
 #include <QObject>
+#include <QSharedPointer>
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QNetworkRequest;
 class QThread;
+class QThreadPool;
 
 
 namespace Zeal {
@@ -43,6 +47,8 @@ class MainWindow;
 
 namespace Core {
 
+class ArchiveStream;
+class DownloadManager;
 class Extractor;
 class FileManager;
 class Settings;
@@ -57,11 +63,17 @@ public:
     static Application *instance();
 
     QNetworkAccessManager *networkManager() const;
+    DownloadManager *downloadManager() const;
     Settings *settings() const;
 
     Registry::DocsetRegistry *docsetRegistry();
     FileManager *fileManager() const;
 
+    QFuture<QString> extract(const QSharedPointer<ArchiveStream> &stream,
+                             const QString &destination, const QString &root = QString());
+    QNetworkReply *download(QNetworkRequest request,
+                            QNetworkAccessManager *networkManager = nullptr);
+
 public slots:
     void executeQuery(const Registry::SearchQuery &query, bool preventActivation);
     void extract(const QString &filePath, const QString &destination, const QString &root = QString());
@@ -88,10 +100,16 @@ private:
 
     QNetworkAccessManager *m_networkManager = nullptr;
 
+    // Docset downloads are received and saved off the GUI thread.
+    QThread *m_downloadThread = nullptr;
+    DownloadManager *m_downloadManager = nullptr;
+
     FileManager *m_fileManager = nullptr;
 
     QThread *m_extractorThread = nullptr;
     Extractor *m_extractor = nullptr;
+    // Stream extractions wait for downloads, keep them off the global thread pool.
+    QThreadPool *m_streamExtractorPool = nullptr;
 
     Registry::DocsetRegistry *m_docsetRegistry = nullptr;
 
@@ -0,0 +1,193 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "archivestream.h"
+
+#include <QFile>
+#include <QMutexLocker>
+
+using namespace Zeal::Core;
+
+namespace {
+// Network replies deliver data in small pieces, the archive is read in larger blocks.
+const qint64 ReadBlockSize = 1024 * 1024;
+// Writers are asked to wait while the reader is this much behind, and to continue once it has
+// caught up by half.
+const qint64 MaxBufferedSize = 64 * 1024 * 1024;
+}
+
+ArchiveStream::ArchiveStream()
+{
+}
+
+ArchiveStream::~ArchiveStream()
+{
+}
+
+/*!
+  Prepends the first \a size bytes of file \a filePath to the stream. The file is read lazily by
+  the reading thread, and must not be truncated until the stream is finished. Must be called
+  before any data is written.
+*/
+void ArchiveStream::writeFile(const QString &filePath, qint64 size)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_isClosed || m_isAborted)
+        return;
+
+    Q_ASSERT(m_chunks.isEmpty() && m_fileRemaining == 0);
+
+    m_filePath = filePath;
+    m_fileRemaining = size;
+    m_dataAvailable.wakeAll();
+}
+
+/*!
+  Appends \a data to the stream. Never blocks, but returns \c false if the reader is too far
+  behind, in which case the writer should stop producing data until the space available handler
+  is called. Does nothing after the stream has been closed or aborted.
+*/
+bool ArchiveStream::write(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return true;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_isClosed || m_isAborted)
+        return true;
+
+    m_chunks.enqueue(data);
+    m_bufferedSize += data.size();
+    m_dataAvailable.wakeAll();
+
+    if (m_bufferedSize < MaxBufferedSize || !m_spaceAvailableHandler)
+        return true;
+
+    m_isWriterWaiting = true;
+    return false;
+}
+
+/*!
+  Sets \a handler called when a writer told to wait by write() can continue. It is called from
+  the reading thread, with the stream locked, so it should only post a notification to the
+  writer. Pass an empty handler before the writer is destroyed.
+*/
+void ArchiveStream::setSpaceAvailableHandler(const std::function<void()> &handler)
+{
+    QMutexLocker locker(&m_mutex);
+    m_spaceAvailableHandler = handler;
+}
+
+/*!
+  Marks the end of data, read() returns an empty array once all written data has been read.
+  Further writes are ignored, so the reader can also close the stream to stop the writer.
+*/
+void ArchiveStream::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_isClosed = true;
+    m_dataAvailable.wakeAll();
+    notifyWriter();
+}
+
+/*!
+  Discards buffered data and makes pending and further reads fail.
+*/
+void ArchiveStream::abort()
+{
+    QMutexLocker locker(&m_mutex);
+    m_isAborted = true;
+    m_chunks.clear();
+    m_bufferedSize = 0;
+    m_dataAvailable.wakeAll();
+    notifyWriter();
+}
+
+bool ArchiveStream::isAborted() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_isAborted;
+}
+
+/*!
+  Returns the next block of data, blocking until it is written. Returns an empty array at the end
+  of the stream, or if the stream has been aborted.
+*/
+QByteArray ArchiveStream::read()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (m_fileRemaining == 0 && m_chunks.isEmpty() && !m_isClosed && !m_isAborted)
+        m_dataAvailable.wait(&m_mutex);
+
+    if (m_isAborted)
+        return QByteArray();
+
+    if (m_fileRemaining > 0) {
+        // The file is only accessed by the reader, do not block writers on disk I/O.
+        const qint64 maxSize = qMin(m_fileRemaining, ReadBlockSize);
+        locker.unlock();
+
+        if (!m_file) {
+            m_file.reset(new QFile(m_filePath));
+            m_file->open(QIODevice::ReadOnly);
+        }
+
+        const QByteArray data = m_file->read(maxSize);
+
+        locker.relock();
+
+        // Let the archive fail as truncated if the file cannot be read.
+        m_fileRemaining = data.isEmpty() ? 0 : m_fileRemaining - data.size();
+        if (m_fileRemaining == 0)
+            m_file.reset();
+
+        return data;
+    }
+
+    if (m_chunks.isEmpty())
+        return QByteArray();
+
+    QByteArray data = m_chunks.dequeue();
+    while (!m_chunks.isEmpty() && data.size() + m_chunks.head().size() <= ReadBlockSize)
+        data += m_chunks.dequeue();
+
+    m_bufferedSize -= data.size();
+    if (m_bufferedSize <= MaxBufferedSize / 2)
+        notifyWriter();
+
+    return data;
+}
+
+/*!
+  \internal
+  Lets a waiting writer continue. Must be called with the stream locked.
+*/
+void ArchiveStream::notifyWriter()
+{
+    if (!m_isWriterWaiting)
+        return;
+
+    m_isWriterWaiting = false;
+    if (m_spaceAvailableHandler)
+        m_spaceAvailableHandler();
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ARCHIVESTREAM_H
+#define ARCHIVESTREAM_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QString>
+#include <QWaitCondition>
+
+#include <functional>
+
+class QFile;
+
+namespace Zeal {
+namespace Core {
+
+// Passes archive data from a download to the thread extracting it.
+class ArchiveStream
+{
+public:
+    ArchiveStream();
+    ~ArchiveStream();
+
+    void writeFile(const QString &filePath, qint64 size);
+    bool write(const QByteArray &data);
+    void setSpaceAvailableHandler(const std::function<void()> &handler);
+    void close();
+    void abort();
+
+    bool isAborted() const;
+
+    QByteArray read();
+
+private:
+    Q_DISABLE_COPY(ArchiveStream)
+
+    void notifyWriter();
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_dataAvailable;
+    QQueue<QByteArray> m_chunks;
+    qint64 m_bufferedSize = 0;
+
+    // Called once a writer told to wait can continue.
+    std::function<void()> m_spaceAvailableHandler;
+    bool m_isWriterWaiting = false;
+    bool m_isClosed = false;
+    bool m_isAborted = false;
+
+    // Data already saved to disk, read by the reader before the chunks.
+    QString m_filePath;
+    qint64 m_fileRemaining = 0;
+    QScopedPointer<QFile> m_file;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ARCHIVESTREAM_H
@@ -0,0 +1,206 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "chunkmanifest.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <array>
+
+using namespace Zeal::Core;
+
+namespace {
+const qint64 ReadBlockSize = 1024 * 1024;
+
+// Chunks are 8 KB on average, boundaries are where the top 13 bits of the fingerprint are zero.
+const qint64 MinChunkSize = 2 * 1024;
+const qint64 MaxChunkSize = 64 * 1024;
+const quint64 BoundaryMask = ~quint64(0) << (64 - 13);
+
+/*!
+  \internal
+  Returns the table of the gear rolling hash. It is generated with SplitMix64 seeded with 0, so
+  that manifests can be produced by other tools.
+*/
+const std::array<quint64, 256> &gearTable()
+{
+    static const std::array<quint64, 256> table = [] {
+        std::array<quint64, 256> table;
+        quint64 state = 0;
+        for (quint64 &value : table) {
+            state += Q_UINT64_C(0x9e3779b97f4a7c15);
+            quint64 z = state;
+            z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+            z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+            value = z ^ (z >> 31);
+        }
+        return table;
+    }();
+
+    return table;
+}
+
+bool isSafePath(const QString &path)
+{
+    return !path.isEmpty() && QDir::isRelativePath(path) && QDir::cleanPath(path) == path
+            && path != QLatin1String("..") && !path.startsWith(QLatin1String("../"));
+}
+}
+
+bool ChunkManifest::isValid() const
+{
+    return m_isValid;
+}
+
+QList<ChunkManifest::File> ChunkManifest::files() const
+{
+    return m_files;
+}
+
+/*!
+  Returns size of the chunk with \a hash, or -1 if the manifest does not list it.
+*/
+qint64 ChunkManifest::chunkSize(const QByteArray &hash) const
+{
+    return m_chunkSizes.value(hash, -1);
+}
+
+/*!
+  Returns total size of all files.
+*/
+qint64 ChunkManifest::size() const
+{
+    qint64 size = 0;
+    for (const File &file : m_files) {
+        for (const QByteArray &hash : file.chunks)
+            size += m_chunkSizes.value(hash);
+    }
+
+    return size;
+}
+
+/*!
+  Parses manifest of a docset revision:
+
+  \code
+  {
+      "chunks": { "<sha256>": <size>, ... },
+      "files": [ { "path": "Contents/Info.plist", "chunks": [ "<sha256>", ... ] }, ... ]
+  }
+  \endcode
+
+  Files are listed with their chunks in order, as produced by split(). Returns an invalid
+  manifest if \a data is malformed, or if any path points outside of the docset directory.
+*/
+ChunkManifest ChunkManifest::fromJson(const QByteArray &data)
+{
+    ChunkManifest manifest;
+
+    const QJsonObject jsonObject = QJsonDocument::fromJson(data).object();
+
+    const QJsonObject chunks = jsonObject.value(QStringLiteral("chunks")).toObject();
+    for (auto it = chunks.constBegin(); it != chunks.constEnd(); ++it) {
+        const qint64 size = static_cast<qint64>(it.value().toDouble());
+        if (size <= 0 || size > MaxChunkSize)
+            return ChunkManifest();
+
+        manifest.m_chunkSizes.insert(it.key().toLatin1().toLower(), size);
+    }
+
+    const QJsonArray files = jsonObject.value(QStringLiteral("files")).toArray();
+    if (files.isEmpty())
+        return ChunkManifest();
+
+    for (const QJsonValue &value : files) {
+        const QJsonObject fileObject = value.toObject();
+
+        File file;
+        file.path = fileObject.value(QStringLiteral("path")).toString();
+        if (!isSafePath(file.path))
+            return ChunkManifest();
+
+        for (const QJsonValue &hashValue : fileObject.value(QStringLiteral("chunks")).toArray()) {
+            const QByteArray hash = hashValue.toString().toLatin1().toLower();
+            if (!manifest.m_chunkSizes.contains(hash))
+                return ChunkManifest();
+
+            file.chunks.append(hash);
+        }
+
+        manifest.m_files.append(file);
+    }
+
+    manifest.m_isValid = true;
+    return manifest;
+}
+
+/*!
+  Splits contents of \a device into content-defined chunks. Boundaries depend only on the
+  preceding bytes of the chunk, so that an edit only changes the chunks around it.
+
+  A gear fingerprint, \c {f = (f << 1) + table[byte]}, is updated with every byte and restarts
+  with each chunk. A chunk ends where at least MinChunkSize bytes are followed by a zero top 13
+  bits of the fingerprint, or at MaxChunkSize bytes.
+*/
+QList<ChunkManifest::Chunk> ChunkManifest::split(QIODevice *device)
+{
+    const std::array<quint64, 256> &table = gearTable();
+
+    QList<Chunk> chunks;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    quint64 fingerprint = 0;
+    qint64 size = 0;
+
+    QByteArray block;
+    while (!(block = device->read(ReadBlockSize)).isEmpty()) {
+        const char *data = block.constData();
+        int start = 0;
+
+        for (int i = 0; i < block.size(); ++i) {
+            fingerprint = (fingerprint << 1) + table[static_cast<uchar>(data[i])];
+            ++size;
+
+            if (size < MaxChunkSize && (size < MinChunkSize || (fingerprint & BoundaryMask)))
+                continue;
+
+            hash.addData(data + start, i + 1 - start);
+            chunks.append({hash.result().toHex(), size});
+
+            hash.reset();
+            fingerprint = 0;
+            size = 0;
+            start = i + 1;
+        }
+
+        hash.addData(data + start, block.size() - start);
+    }
+
+    if (size > 0)
+        chunks.append({hash.result().toHex(), size});
+
+    return chunks;
+}
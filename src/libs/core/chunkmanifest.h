@@ -0,0 +1,69 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_CORE_CHUNKMANIFEST_H
+#define ZEAL_CORE_CHUNKMANIFEST_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+namespace Zeal {
+namespace Core {
+
+class ChunkManifest
+{
+public:
+    struct Chunk
+    {
+        QByteArray hash; // Hex encoded SHA-256.
+        qint64 size;
+    };
+
+    struct File
+    {
+        QString path; // Relative to the docset directory.
+        QList<QByteArray> chunks;
+    };
+
+    bool isValid() const;
+
+    QList<File> files() const;
+    qint64 chunkSize(const QByteArray &hash) const;
+    qint64 size() const;
+
+    static ChunkManifest fromJson(const QByteArray &data);
+    static QList<Chunk> split(QIODevice *device);
+
+private:
+    bool m_isValid = false;
+    QList<File> m_files;
+    QHash<QByteArray, qint64> m_chunkSizes;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_CHUNKMANIFEST_H
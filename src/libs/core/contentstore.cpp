@@ -0,0 +1,265 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "contentstore.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#include <cerrno>
+
+using namespace Zeal::Core;
+
+static Q_LOGGING_CATEGORY(log, "zeal.core.contentstore")
+
+namespace {
+const char StoreDirectoryName[] = ".store";
+
+#ifdef Q_OS_WIN32
+std::wstring nativePath(const QString &path)
+{
+    return QDir::toNativeSeparators(path).toStdWString();
+}
+#endif
+
+#ifdef Q_OS_LINUX
+// Shares data of the files on filesystems that support it, such as Btrfs or XFS.
+bool cloneFile(const QString &sourcePath, const QString &targetPath)
+{
+#ifdef FICLONE
+    const int source = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0)
+        return false;
+
+    const QByteArray target = QFile::encodeName(targetPath);
+    const int destination = ::open(target.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                   0644);
+    if (destination < 0) {
+        ::close(source);
+        return false;
+    }
+
+    const bool ok = ::ioctl(destination, FICLONE, source) == 0;
+    ::close(destination);
+    ::close(source);
+
+    if (!ok)
+        ::unlink(target.constData());
+
+    return ok;
+#else
+    Q_UNUSED(sourcePath)
+    Q_UNUSED(targetPath)
+    return false;
+#endif
+}
+#endif
+
+/*!
+  \internal
+  Creates \a linkPath as a hard link to \a targetPath. Unless \a hardLinkOnly is set, falls back
+  to a reflink where hard links are not possible, for example when the file already has too many
+  links. Stored files must be hard links, since unused ones are found by their link count.
+*/
+bool createLink(const QString &targetPath, const QString &linkPath, bool hardLinkOnly = false)
+{
+#ifdef Q_OS_WIN32
+    Q_UNUSED(hardLinkOnly)
+    return CreateHardLinkW(nativePath(linkPath).c_str(), nativePath(targetPath).c_str(),
+                           nullptr) != 0;
+#else
+    if (::link(QFile::encodeName(targetPath).constData(),
+               QFile::encodeName(linkPath).constData()) == 0) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    if (!hardLinkOnly && errno != EEXIST && errno != ENOENT)
+        return cloneFile(targetPath, linkPath);
+#else
+    Q_UNUSED(hardLinkOnly)
+#endif
+
+    return false;
+#endif
+}
+
+// Returns the number of hard links to a file, or 0 if it cannot be determined.
+qint64 linkCount(const QString &filePath)
+{
+#ifdef Q_OS_WIN32
+    HANDLE handle = CreateFileW(nativePath(filePath).c_str(), 0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return 0;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    const bool ok = GetFileInformationByHandle(handle, &info);
+    CloseHandle(handle);
+
+    return ok ? info.nNumberOfLinks : 0;
+#else
+    struct stat info;
+    if (::stat(QFile::encodeName(filePath).constData(), &info) != 0)
+        return 0;
+
+    return info.st_nlink;
+#endif
+}
+}
+
+/*!
+  \class Zeal::Core::ContentStore
+  Keeps a single copy of identical files across docsets and their versions. Files are known by
+  their SHA-256 hash, and stored as hard links in a hidden directory of \a storagePath. Files of
+  a docset link to the stored copy instead of holding their own data.
+
+  Files linked this way must never be written to, so only the documentation pages and their
+  resources are shared. Docset indexes are modified after installation, and stay separate.
+*/
+ContentStore::ContentStore(const QString &storagePath) :
+    m_path(QDir(storagePath).filePath(QLatin1String(StoreDirectoryName)))
+{
+}
+
+QString ContentStore::path() const
+{
+    return m_path;
+}
+
+/*!
+  Creates \a filePath from the stored file with \a hash. Returns \c false if no such file is
+  stored, or if \a filePath cannot be linked to it.
+*/
+bool ContentStore::link(const QByteArray &hash, const QString &filePath) const
+{
+    return createLink(objectPath(hash), filePath);
+}
+
+/*!
+  Adds \a filePath with \a hash to the store. If an identical file is already stored,
+  \a filePath is replaced with a link to it. Returns \c false if the file cannot be shared.
+*/
+bool ContentStore::insert(const QByteArray &hash, const QString &filePath) const
+{
+    const QString storedPath = objectPath(hash);
+    if (!QDir().mkpath(QFileInfo(storedPath).path()))
+        return false;
+
+    // A reflinked copy would not count as a link, and be removed as unused.
+    if (createLink(filePath, storedPath, true))
+        return true;
+
+    // Link first, so that the file stays in place if linking fails.
+    const QString linkPath = filePath + QLatin1String(".link");
+    QFile::remove(linkPath);
+    if (!createLink(storedPath, linkPath))
+        return false;
+
+    if (!QFile::remove(filePath)) {
+        QFile::remove(linkPath);
+        return false;
+    }
+
+    if (!QFile::rename(linkPath, filePath)) {
+        qCWarning(log, "Cannot rename '%s' to '%s'.", qPrintable(linkPath), qPrintable(filePath));
+        return QFile::copy(storedPath, filePath) && QFile::remove(linkPath);
+    }
+
+    return true;
+}
+
+/*!
+  Removes stored files that are no longer part of any docset. Returns the number of removed files.
+*/
+int ContentStore::removeUnused() const
+{
+    int count = 0;
+
+    QDirIterator it(m_path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString filePath = it.next();
+        if (linkCount(filePath) != 1)
+            continue;
+
+        if (QFile::remove(filePath))
+            ++count;
+    }
+
+    qCDebug(log, "Removed %d unused files from '%s'.", count, qPrintable(m_path));
+    return count;
+}
+
+/*!
+  Returns whether \a filePath belongs to the docset content that can be shared.
+*/
+bool ContentStore::isShareable(const QString &filePath)
+{
+    return filePath.contains(QLatin1String("/Contents/Resources/Documents/"));
+}
+
+/*!
+  Returns disk space that docset in \a docsetPath saves by sharing files with other docsets.
+  Space taken by a shared file is split equally between the docsets that link to it.
+
+  Reflinked files are not detected, and are not accounted for.
+*/
+qint64 ContentStore::savedSize(const QString &docsetPath)
+{
+    qint64 size = 0;
+
+    QDirIterator it(QDir(docsetPath).filePath(QStringLiteral("Contents/Resources/Documents")),
+                    QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+
+        // One of the links is held by the store.
+        const qint64 sharingCount = linkCount(it.filePath()) - 1;
+        if (sharingCount > 1)
+            size += it.fileInfo().size() * (sharingCount - 1) / sharingCount;
+    }
+
+    return size;
+}
+
+QString ContentStore::objectPath(const QByteArray &hash) const
+{
+    const QString name = QString::fromLatin1(hash);
+    return m_path + QLatin1Char('/') + name.left(2) + QLatin1Char('/') + name;
+}
@@ -0,0 +1,55 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_CORE_CONTENTSTORE_H
+#define ZEAL_CORE_CONTENTSTORE_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace Zeal {
+namespace Core {
+
+class ContentStore
+{
+public:
+    explicit ContentStore(const QString &storagePath);
+
+    QString path() const;
+
+    bool link(const QByteArray &hash, const QString &filePath) const;
+    bool insert(const QByteArray &hash, const QString &filePath) const;
+    int removeUnused() const;
+
+    static bool isShareable(const QString &filePath);
+    static qint64 savedSize(const QString &docsetPath);
+
+private:
+    QString objectPath(const QByteArray &hash) const;
+
+    QString m_path;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_CONTENTSTORE_H
@@ -0,0 +1,437 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "deltaupdate.h"
+
+#include "application.h"
+#include "contentstore.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QNetworkReply>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTemporaryFile>
+
+#include <QtConcurrent>
+
+using namespace Zeal::Core;
+
+namespace {
+const int MaxRedirects = 10;
+// Chunks are small, keep a few requests in flight to hide latency.
+const int MaxConcurrentRequests = 6;
+// Chunks are fetched uncompressed unless the server compresses responses. Past this share of
+// the docset the archive is cheaper to download.
+const double MaxMissingRatio = 0.5;
+}
+
+/*!
+  \class Zeal::Core::DeltaUpdate
+  Updates docset installed in \a docsetPath to the revision described by the chunk manifest at
+  \a manifestUrl, writing the new revision into \a targetPath.
+
+  Chunks of the installed files are reused, only the missing ones are downloaded. They are
+  expected at \c chunks/<sha256> relative to the manifest. When finished with an error, the
+  docset should be downloaded in full.
+
+  \sa ChunkManifest
+*/
+DeltaUpdate::DeltaUpdate(const QUrl &manifestUrl, const QString &docsetPath,
+                         const QString &targetPath, QObject *parent) :
+    QObject(parent),
+    m_manifestUrl(manifestUrl),
+    m_docsetPath(docsetPath),
+    m_targetPath(targetPath),
+    m_aborted(new QAtomicInt(0))
+{
+}
+
+DeltaUpdate::~DeltaUpdate()
+{
+    m_aborted->storeRelease(1);
+}
+
+QUrl DeltaUpdate::manifestUrl() const
+{
+    return m_manifestUrl;
+}
+
+QString DeltaUpdate::storagePath() const
+{
+    return m_storagePath;
+}
+
+/*!
+  Shares written docset files with other docsets through the ContentStore in \a storagePath.
+  Files are written separately if \a storagePath is empty, which is the default.
+*/
+void DeltaUpdate::setStoragePath(const QString &storagePath)
+{
+    m_storagePath = storagePath;
+}
+
+bool DeltaUpdate::isFinished() const
+{
+    return m_isFinished;
+}
+
+bool DeltaUpdate::isAborted() const
+{
+    return m_aborted->loadAcquire() != 0;
+}
+
+QString DeltaUpdate::errorString() const
+{
+    return m_errorString;
+}
+
+qint64 DeltaUpdate::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+/*!
+  Returns size of the chunks to download, or 0 until it is known.
+*/
+qint64 DeltaUpdate::bytesTotal() const
+{
+    return m_bytesTotal;
+}
+
+void DeltaUpdate::start()
+{
+    get(m_manifestUrl, [this](QNetworkReply *reply) {
+        handleManifest(reply);
+    });
+}
+
+void DeltaUpdate::abort()
+{
+    if (m_isFinished)
+        return;
+
+    m_aborted->storeRelease(1);
+
+    // Finishes once the running job returns, so that it does not outlive the update.
+    if (m_isJobRunning)
+        return;
+
+    finish(tr("Operation canceled"));
+}
+
+QNetworkReply *DeltaUpdate::get(const QUrl &url, const ReplyHandler &handler, int redirectCount)
+{
+    QNetworkReply *reply = Application::instance()->download(url);
+    m_replies.append(reply);
+
+    connect(reply, &QNetworkReply::finished, this, [this, reply, handler, redirectCount] {
+        reply->deleteLater();
+        m_replies.removeOne(reply);
+
+        if (m_isFinished)
+            return;
+
+        const QUrl redirectUrl
+                = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+        if (reply->error() == QNetworkReply::NoError && redirectUrl.isValid()) {
+            if (redirectCount >= MaxRedirects) {
+                finish(tr("Too many redirects"));
+                return;
+            }
+
+            get(reply->url().resolved(redirectUrl), handler, redirectCount + 1);
+            return;
+        }
+
+        handler(reply);
+    });
+
+    return reply;
+}
+
+void DeltaUpdate::handleManifest(QNetworkReply *reply)
+{
+    if (reply->error() != QNetworkReply::NoError) {
+        finish(reply->errorString());
+        return;
+    }
+
+    m_manifest = ChunkManifest::fromJson(reply->readAll());
+    if (!m_manifest.isValid()) {
+        finish(tr("Invalid docset manifest"));
+        return;
+    }
+
+    const ChunkManifest manifest = m_manifest;
+    const QString docsetPath = m_docsetPath;
+    const QSharedPointer<QAtomicInt> aborted = m_aborted;
+
+    QFutureWatcher<ChunkIndex> *watcher = new QFutureWatcher<ChunkIndex>(this);
+    connect(watcher, &QFutureWatcher<ChunkIndex>::finished, this, [this, watcher] {
+        watcher->deleteLater();
+        m_isJobRunning = false;
+
+        if (isAborted()) {
+            finish(tr("Operation canceled"));
+            return;
+        }
+
+        m_chunkIndex = watcher->result();
+
+        QSet<QByteArray> missingChunks;
+        for (const ChunkManifest::File &file : m_manifest.files()) {
+            for (const QByteArray &hash : file.chunks) {
+                if (m_chunkIndex.contains(hash) || missingChunks.contains(hash))
+                    continue;
+
+                missingChunks.insert(hash);
+                m_missingChunks.append(hash);
+                m_bytesTotal += m_manifest.chunkSize(hash);
+            }
+        }
+
+        if (m_bytesTotal > m_manifest.size() * MaxMissingRatio) {
+            finish(tr("Too much has changed for a delta update"));
+            return;
+        }
+
+        m_chunkFile = new QTemporaryFile(this);
+        if (!m_chunkFile->open()) {
+            finish(tr("Cannot create temporary file: %1").arg(m_chunkFile->errorString()));
+            return;
+        }
+
+        emit progress(0, m_bytesTotal);
+
+        if (m_missingChunks.isEmpty()) {
+            assemble();
+            return;
+        }
+
+        fetchChunks();
+    });
+
+    m_isJobRunning = true;
+    watcher->setFuture(QtConcurrent::run([manifest, docsetPath, aborted] {
+        return indexChunks(manifest, docsetPath, aborted);
+    }));
+}
+
+void DeltaUpdate::fetchChunks()
+{
+    while (m_replies.size() < MaxConcurrentRequests && !m_missingChunks.isEmpty()) {
+        const QByteArray hash = m_missingChunks.takeFirst();
+        const QUrl url = m_manifestUrl.resolved(QUrl(QLatin1String("chunks/")
+                                                     + QLatin1String(hash)));
+        get(url, [this, hash](QNetworkReply *reply) {
+            handleChunk(hash, reply);
+        });
+    }
+}
+
+void DeltaUpdate::handleChunk(const QByteArray &hash, QNetworkReply *reply)
+{
+    if (reply->error() != QNetworkReply::NoError) {
+        finish(reply->errorString());
+        return;
+    }
+
+    const QByteArray data = reply->readAll();
+    if (data.size() != m_manifest.chunkSize(hash)
+            || QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex() != hash) {
+        finish(tr("Chunk %1 is corrupted").arg(QLatin1String(hash)));
+        return;
+    }
+
+    const qint64 offset = m_chunkFile->pos();
+    if (m_chunkFile->write(data) != data.size()) {
+        finish(tr("Cannot write to %1: %2").arg(m_chunkFile->fileName(),
+                                                m_chunkFile->errorString()));
+        return;
+    }
+
+    m_chunkIndex.insert(hash, {m_chunkFile->fileName(), offset});
+
+    m_bytesReceived += data.size();
+    emit progress(m_bytesReceived, m_bytesTotal);
+
+    if (m_missingChunks.isEmpty() && m_replies.isEmpty()) {
+        assemble();
+        return;
+    }
+
+    fetchChunks();
+}
+
+/*!
+  \internal
+  Writes files of the new revision from the collected chunks.
+*/
+void DeltaUpdate::assemble()
+{
+    m_chunkFile->flush();
+
+    const ChunkManifest manifest = m_manifest;
+    const ChunkIndex index = m_chunkIndex;
+    const QString targetPath = m_targetPath;
+    const QString storagePath = m_storagePath;
+    const QSharedPointer<QAtomicInt> aborted = m_aborted;
+
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher] {
+        watcher->deleteLater();
+        m_isJobRunning = false;
+
+        finish(isAborted() ? tr("Operation canceled") : watcher->result());
+    });
+
+    m_isJobRunning = true;
+    watcher->setFuture(QtConcurrent::run([manifest, index, targetPath, storagePath, aborted] {
+        return writeFiles(manifest, index, targetPath, storagePath, aborted);
+    }));
+}
+
+void DeltaUpdate::finish(const QString &errorString)
+{
+    if (m_isFinished)
+        return;
+
+    m_isFinished = true;
+    m_errorString = errorString;
+
+    for (QNetworkReply *reply : QList<QNetworkReply *>(m_replies))
+        reply->abort();
+
+    delete m_chunkFile;
+    m_chunkFile = nullptr;
+
+    emit finished();
+}
+
+/*!
+  \internal
+  Splits files of the installed docset, and returns locations of the chunks listed in
+  \a manifest. Only files present in the new revision are read.
+*/
+DeltaUpdate::ChunkIndex DeltaUpdate::indexChunks(const ChunkManifest &manifest,
+                                                 const QString &docsetPath,
+                                                 const QSharedPointer<QAtomicInt> &aborted)
+{
+    const QDir docsetDir(docsetPath);
+
+    ChunkIndex index;
+    for (const ChunkManifest::File &file : manifest.files()) {
+        if (aborted->loadAcquire())
+            break;
+
+        const QString filePath = docsetDir.filePath(file.path);
+
+        QFile source(filePath);
+        if (!source.open(QIODevice::ReadOnly))
+            continue;
+
+        qint64 offset = 0;
+        for (const ChunkManifest::Chunk &chunk : ChunkManifest::split(&source)) {
+            if (manifest.chunkSize(chunk.hash) == chunk.size && !index.contains(chunk.hash))
+                index.insert(chunk.hash, {filePath, offset});
+
+            offset += chunk.size;
+        }
+    }
+
+    return index;
+}
+
+/*!
+  \internal
+  Writes files listed in \a manifest into \a targetPath, reading their chunks from locations
+  in \a index. Unless \a storagePath is empty, files are shared through its content store.
+  Returns an error string, or an empty string on success.
+*/
+QString DeltaUpdate::writeFiles(const ChunkManifest &manifest, const ChunkIndex &index,
+                                const QString &targetPath, const QString &storagePath,
+                                const QSharedPointer<QAtomicInt> &aborted)
+{
+    const QDir targetDir(targetPath);
+
+    QScopedPointer<ContentStore> store;
+    if (!storagePath.isEmpty())
+        store.reset(new ContentStore(storagePath));
+
+    QScopedPointer<QFile> source;
+    QString directoryPath;
+
+    for (const ChunkManifest::File &file : manifest.files()) {
+        if (aborted->loadAcquire())
+            return QString();
+
+        const QString filePath = targetDir.filePath(file.path);
+
+        const QString parentPath = QFileInfo(filePath).path();
+        if (parentPath != directoryPath) {
+            if (!QDir().mkpath(parentPath))
+                return tr("Cannot create directory %1").arg(parentPath);
+            directoryPath = parentPath;
+        }
+
+        const bool isShared = store && ContentStore::isShareable(filePath);
+        QCryptographicHash fileHash(QCryptographicHash::Sha256);
+
+        QFile target(filePath);
+        if (!target.open(QIODevice::WriteOnly))
+            return tr("Cannot write to %1: %2").arg(filePath, target.errorString());
+
+        for (const QByteArray &hash : file.chunks) {
+            const ChunkLocation location = index.value(hash);
+            if (source.isNull() || source->fileName() != location.filePath) {
+                source.reset(new QFile(location.filePath));
+                if (!source->open(QIODevice::ReadOnly))
+                    return tr("Cannot read %1: %2").arg(location.filePath, source->errorString());
+            }
+
+            const qint64 size = manifest.chunkSize(hash);
+            QByteArray data;
+            if (source->seek(location.offset))
+                data = source->read(size);
+
+            if (data.size() != size)
+                return tr("Cannot read %1: %2").arg(location.filePath, source->errorString());
+
+            if (target.write(data) != data.size())
+                return tr("Cannot write to %1: %2").arg(filePath, target.errorString());
+
+            if (isShared)
+                fileHash.addData(data);
+        }
+
+        if (isShared) {
+            target.close();
+            store->insert(fileHash.result().toHex(), filePath);
+        }
+    }
+
+    return QString();
+}
@@ -0,0 +1,119 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_CORE_DELTAUPDATE_H
+#define ZEAL_CORE_DELTAUPDATE_H
+
+#include "chunkmanifest.h"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QUrl>
+
+#include <functional>
+
+class QNetworkReply;
+class QTemporaryFile;
+
+namespace Zeal {
+namespace Core {
+
+class DeltaUpdate : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DeltaUpdate(const QUrl &manifestUrl, const QString &docsetPath,
+                         const QString &targetPath, QObject *parent = nullptr);
+    ~DeltaUpdate() override;
+
+    QUrl manifestUrl() const;
+
+    QString storagePath() const;
+    void setStoragePath(const QString &storagePath);
+
+    bool isFinished() const;
+    bool isAborted() const;
+    QString errorString() const;
+
+    qint64 bytesReceived() const;
+    qint64 bytesTotal() const;
+
+public slots:
+    void start();
+    void abort();
+
+signals:
+    void progress(qint64 received, qint64 total);
+    void finished();
+
+private:
+    struct ChunkLocation
+    {
+        QString filePath;
+        qint64 offset;
+    };
+
+    typedef QHash<QByteArray, ChunkLocation> ChunkIndex;
+    typedef std::function<void(QNetworkReply *)> ReplyHandler;
+
+    QNetworkReply *get(const QUrl &url, const ReplyHandler &handler, int redirectCount = 0);
+    void handleManifest(QNetworkReply *reply);
+    void handleChunk(const QByteArray &hash, QNetworkReply *reply);
+    void fetchChunks();
+    void assemble();
+    void finish(const QString &errorString);
+
+    static ChunkIndex indexChunks(const ChunkManifest &manifest, const QString &docsetPath,
+                                  const QSharedPointer<QAtomicInt> &aborted);
+    static QString writeFiles(const ChunkManifest &manifest, const ChunkIndex &index,
+                              const QString &targetPath, const QString &storagePath,
+                              const QSharedPointer<QAtomicInt> &aborted);
+
+    QUrl m_manifestUrl;
+    QString m_docsetPath;
+    QString m_targetPath;
+    QString m_storagePath;
+
+    ChunkManifest m_manifest;
+    ChunkIndex m_chunkIndex;
+
+    // Chunks missing from the installed docset are appended to a temporary file.
+    QList<QByteArray> m_missingChunks;
+    QTemporaryFile *m_chunkFile = nullptr;
+    QList<QNetworkReply *> m_replies;
+
+    qint64 m_bytesReceived = 0;
+    qint64 m_bytesTotal = 0;
+
+    // Shared with the indexing and writing jobs.
+    QSharedPointer<QAtomicInt> m_aborted;
+    bool m_isJobRunning = false;
+    bool m_isFinished = false;
+    QString m_errorString;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_DELTAUPDATE_H
@@ -0,0 +1,673 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "download.h"
+
+#include "application.h"
+#include "archivestream.h"
+#include "downloadmanager.h"
+#include "mirrorranker.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QThread>
+#include <QTimer>
+
+using namespace Zeal::Core;
+
+namespace {
+const int MaxRedirects = 10;
+// Time without any data after which the next mirror is tried.
+const int StallTimeout = 30000; // ms
+// Limits progress updates passed to the GUI thread.
+const int ProgressInterval = 100; // ms
+// Received data is written to disk in blocks of this size.
+const int FileBufferSize = 1024 * 1024;
+// Data held by a reply while reading is paused, beyond it the socket is no longer read.
+const qint64 PausedReadBufferSize = 1024 * 1024;
+const char MetadataFileSuffix[] = ".json";
+}
+
+/*!
+  \class Zeal::Core::Download
+  A download is created in the thread requesting it, and is moved to the thread of DownloadManager
+  before it starts. Received data is written to the disk and to the archive stream in that thread,
+  only signals reach the requester.
+*/
+Download::Download(const QList<QUrl> &urls, Priority priority, DownloadManager *manager) :
+    m_urls(urls),
+    m_priority(priority),
+    m_mirrorRanker(manager->mirrorRanker()),
+    m_networkManager(manager->networkManager())
+{
+    m_stallTimer = new QTimer(this);
+    m_stallTimer->setInterval(StallTimeout);
+    m_stallTimer->setSingleShot(true);
+    connect(m_stallTimer, &QTimer::timeout, this, &Download::handleStall);
+}
+
+Download::~Download()
+{
+    if (!m_archiveStream)
+        return;
+
+    m_archiveStream->setSpaceAvailableHandler(nullptr);
+
+    // Do not leave the extraction waiting for data that will not come.
+    if (!m_isFinished)
+        m_archiveStream->abort();
+}
+
+/*!
+  Returns URL of the mirror currently used.
+*/
+QUrl Download::url() const
+{
+    return m_urls.at(m_urlIndex);
+}
+
+/*!
+  Returns URLs of all mirrors of the file. Once the download has started, they are ordered by
+  preference.
+*/
+QList<QUrl> Download::urls() const
+{
+    return m_urls;
+}
+
+Download::Priority Download::priority() const
+{
+    return m_priority;
+}
+
+QString Download::filePath() const
+{
+    return m_filePath;
+}
+
+/*!
+  Saves downloaded data to \a filePath. If a previous download of the same file has been
+  interrupted, it is resumed from the data already saved, provided the server confirms the file
+  has not changed. Must be called before the download starts.
+
+  The file is kept after a failure, so that the download can be resumed later, and after success.
+  Use removeFile() once it is no longer needed.
+*/
+void Download::setFilePath(const QString &filePath)
+{
+    Q_ASSERT(!m_reply);
+    m_filePath = filePath;
+}
+
+/*!
+  Returns the number of bytes that have been saved to filePath() by a previous download. Valid
+  once data is received.
+*/
+qint64 Download::resumeOffset() const
+{
+    return m_offset;
+}
+
+QSharedPointer<ArchiveStream> Download::archiveStream() const
+{
+    return m_archiveStream;
+}
+
+/*!
+  Passes downloaded data to \a stream, starting with the part saved by a previous download, if
+  any. The stream is closed once the download succeeds, and aborted if it fails. Must be called
+  before the download starts.
+*/
+void Download::setArchiveStream(const QSharedPointer<ArchiveStream> &stream)
+{
+    Q_ASSERT(!m_reply);
+    m_archiveStream = stream;
+
+    // The download thread is shared by all downloads, so it is never blocked on the stream.
+    // Reading is paused instead, and resumed from the thread of the download.
+    m_archiveStream->setSpaceAvailableHandler([this] {
+        QMetaObject::invokeMethod(this, "resumeReading", Qt::QueuedConnection);
+    });
+}
+
+bool Download::isRunning() const
+{
+    return m_reply && !m_isFinished;
+}
+
+bool Download::isFinished() const
+{
+    return m_isFinished;
+}
+
+/*!
+  Returns the number of bytes downloaded, including the resumed part.
+*/
+qint64 Download::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+/*!
+  Returns the size of the file being downloaded, or -1 if it is not known yet.
+*/
+qint64 Download::bytesTotal() const
+{
+    return m_bytesTotal;
+}
+
+QNetworkReply::NetworkError Download::error() const
+{
+    return m_error;
+}
+
+QString Download::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+  Removes partial download \a filePath along with its metadata.
+*/
+void Download::removeFile(const QString &filePath)
+{
+    if (filePath.isEmpty())
+        return;
+
+    QFile::remove(filePath);
+    QFile::remove(filePath + QLatin1String(MetadataFileSuffix));
+}
+
+/*!
+  Cancels the download. If it has not started yet, it is removed from the queue.
+  Emits finished() with QNetworkReply::OperationCanceledError. Can be called from any thread.
+*/
+void Download::abort()
+{
+    if (thread() != QThread::currentThread()) {
+        QMetaObject::invokeMethod(this, "abort", Qt::QueuedConnection);
+        return;
+    }
+
+    if (m_isFinished)
+        return;
+
+    // The reply finishes with OperationCanceledError.
+    if (m_reply) {
+        m_reply->abort();
+        return;
+    }
+
+    finish(QNetworkReply::OperationCanceledError, tr("Operation canceled"));
+}
+
+void Download::start()
+{
+    m_urls = m_mirrorRanker->rank(m_urls);
+
+    if (!m_filePath.isEmpty())
+        loadMetadata();
+
+    get(url());
+    emit started();
+}
+
+void Download::get(const QUrl &url)
+{
+    if (m_reply) {
+        m_reply->disconnect(this);
+        m_reply->abort();
+        m_reply->deleteLater();
+    }
+
+    QNetworkRequest request(url);
+    // Byte ranges must refer to the file itself, not to a compressed transfer of it.
+    request.setRawHeader("Accept-Encoding", "identity");
+
+    if (m_bytesReceived > 0) {
+        request.setRawHeader("Range", "bytes=" + QByteArray::number(m_bytesReceived) + '-');
+
+        // Sends the whole file instead if it has changed. Other mirrors have their own validators,
+        // the file size is checked instead.
+        if (this->url() == m_validatorUrl) {
+            request.setRawHeader("If-Range", m_entityTag.isEmpty() ? m_lastModified
+                                                                   : m_entityTag);
+        }
+    }
+
+    m_reply = Application::instance()->download(request, m_networkManager);
+    m_reply->setParent(this);
+    m_isContentPrepared = false;
+    if (m_isReadingPaused)
+        m_reply->setReadBufferSize(PausedReadBufferSize);
+
+    connect(m_reply, &QNetworkReply::readyRead, this, &Download::handleReadyRead);
+    connect(m_reply, &QNetworkReply::downloadProgress, this, [this] {
+        // A paused reply stops receiving data on purpose.
+        if (!m_isReadingPaused)
+            m_stallTimer->start();
+
+        if (!prepareContent())
+            return;
+
+        m_bytesTotal = m_expectedSize;
+
+        if (m_progressTimer.isValid() && m_progressTimer.elapsed() < ProgressInterval)
+            return;
+
+        m_progressTimer.start();
+        emit progress(m_bytesReceived, m_bytesTotal);
+    });
+    connect(m_reply, &QNetworkReply::finished, this, &Download::handleFinished);
+
+    if (!m_isReadingPaused)
+        m_stallTimer->start();
+}
+
+void Download::finish(QNetworkReply::NetworkError error, QString errorString)
+{
+    m_stallTimer->stop();
+
+    if (error == QNetworkReply::NoError)
+        recordTransfer();
+    else if (error != QNetworkReply::OperationCanceledError)
+        m_mirrorRanker->recordFailure(url());
+
+    if (m_file) {
+        // Data received before a failure is kept for resuming.
+        if (!flushFile() && error == QNetworkReply::NoError) {
+            error = QNetworkReply::UnknownContentError;
+            errorString = tr("Cannot write to %1: %2").arg(m_filePath, m_file->errorString());
+        }
+
+        m_file->close();
+
+        // Without validators it cannot be known whether the rest of the file would match.
+        if (error != QNetworkReply::NoError && m_entityTag.isEmpty() && m_lastModified.isEmpty())
+            removeFile(m_filePath);
+    }
+
+    if (m_archiveStream) {
+        if (error == QNetworkReply::NoError)
+            m_archiveStream->close();
+        else
+            m_archiveStream->abort();
+    }
+
+    m_isFinished = true;
+    m_error = error;
+    m_errorString = errorString;
+
+    emit finished();
+}
+
+/*!
+  \internal
+  Stops the running reply and finishes with \a error, unlike abort().
+*/
+void Download::fail(QNetworkReply::NetworkError error, const QString &errorString)
+{
+    m_reply->disconnect(this);
+    m_reply->abort();
+
+    finish(error, errorString);
+}
+
+/*!
+  \internal
+  Continues the download from the next mirror, unless all mirrors have been tried.
+*/
+bool Download::failOver()
+{
+    if (m_failoverCount + 1 >= m_urls.size())
+        return false;
+
+    recordTransfer();
+    m_mirrorRanker->recordFailure(url());
+
+    ++m_failoverCount;
+    m_urlIndex = (m_urlIndex + 1) % m_urls.size();
+    m_redirectCount = 0;
+
+    get(url());
+    return true;
+}
+
+void Download::recordTransfer()
+{
+    if (!m_mirrorTimer.isValid())
+        return;
+
+    m_mirrorRanker->recordTransfer(url(), m_mirrorBytesReceived, m_mirrorTimer.elapsed());
+    m_mirrorTimer.invalidate();
+    m_mirrorBytesReceived = 0;
+}
+
+// Only the requested file is passed on, not bodies of redirects or error pages.
+bool Download::hasContent() const
+{
+    const int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return statusCode == 200 || (statusCode == 206 && m_bytesReceived > 0);
+}
+
+/*!
+  \internal
+  Returns whether the current reply carries the requested file. When it does, opens the file the
+  data is saved to, continuing the download if the server has sent the missing range. A mirror
+  sending a different file is abandoned.
+*/
+bool Download::prepareContent()
+{
+    if (m_isContentPrepared)
+        return true;
+
+    if (!hasContent())
+        return false;
+
+    if (m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 206) {
+        // Content-Range: bytes <first>-<last>/<size>
+        static const QRegularExpression rangeRegExp(
+                    QStringLiteral("^bytes\\s+(\\d+)-(\\d+)/(\\d+|\\*)$"));
+        const QRegularExpressionMatch match
+                = rangeRegExp.match(QString::fromLatin1(m_reply->rawHeader("Content-Range")));
+        const qint64 size = match.captured(3) == QLatin1String("*")
+                ? -1 : match.captured(3).toLongLong();
+
+        if (!match.hasMatch() || match.captured(1).toLongLong() != m_bytesReceived
+                || (m_expectedSize != -1 && size != -1 && size != m_expectedSize)) {
+            if (!failOver())
+                fail(QNetworkReply::ProtocolFailure, tr("Server has sent an unexpected file range"));
+            return false;
+        }
+
+        if (size != -1)
+            m_expectedSize = size;
+    } else {
+        const QVariant contentLength = m_reply->header(QNetworkRequest::ContentLengthHeader);
+        const qint64 size = contentLength.isValid() ? contentLength.toLongLong() : -1;
+
+        if (m_bytesReceived > m_offset) {
+            // Data has been passed on already, skip it if this mirror has the same file.
+            if (size == -1 || (m_expectedSize != -1 && size != m_expectedSize)) {
+                if (!failOver())
+                    fail(QNetworkReply::ProtocolFailure, tr("Mirrors have different files"));
+                return false;
+            }
+
+            m_skipBytes = m_bytesReceived;
+        } else {
+            // The file has changed, or the server does not support ranges.
+            m_offset = 0;
+            m_bytesReceived = 0;
+            m_fileBuffer.clear();
+            if (m_file)
+                m_file->resize(0);
+        }
+
+        m_expectedSize = size;
+    }
+
+    m_isContentPrepared = true;
+    m_mirrorTimer.start();
+
+    m_validatorUrl = url();
+    m_entityTag = m_reply->rawHeader("ETag");
+    // Weak validators cannot be used with If-Range.
+    if (m_entityTag.startsWith("W/"))
+        m_entityTag.clear();
+    m_lastModified = m_reply->rawHeader("Last-Modified");
+
+    if (m_filePath.isEmpty())
+        return true;
+
+    if (!m_file) {
+        m_file = new QFile(m_filePath, this);
+        const QIODevice::OpenMode mode = m_bytesReceived > 0
+                ? QIODevice::Append : QIODevice::WriteOnly | QIODevice::Truncate;
+        if (!m_file->open(mode)) {
+            const QString errorString = tr("Cannot write to %1: %2")
+                    .arg(m_filePath, m_file->errorString());
+            delete m_file;
+            m_file = nullptr;
+            fail(QNetworkReply::UnknownContentError, errorString);
+            return false;
+        }
+    }
+
+    saveMetadata();
+
+    return true;
+}
+
+/*!
+  \internal
+  Reads validators of the partial download saved to filePath(), and decides whether it can be
+  resumed. Otherwise, removes the partial download.
+*/
+void Download::loadMetadata()
+{
+    QFile file(m_filePath + QLatin1String(MetadataFileSuffix));
+    const QJsonObject jsonObject = file.open(QIODevice::ReadOnly)
+            ? QJsonDocument::fromJson(file.readAll()).object() : QJsonObject();
+
+    const qint64 size = QFileInfo(m_filePath).size();
+    const qint64 expectedSize = static_cast<qint64>(jsonObject[QStringLiteral("size")].toDouble(-1));
+
+    m_entityTag = jsonObject[QStringLiteral("etag")].toString().toLatin1();
+    m_lastModified = jsonObject[QStringLiteral("last_modified")].toString().toLatin1();
+
+    const QUrl validatorUrl(jsonObject[QStringLiteral("url")].toString());
+
+    if (!m_urls.contains(validatorUrl)
+            || (m_entityTag.isEmpty() && m_lastModified.isEmpty())
+            || size <= 0 || (expectedSize != -1 && size >= expectedSize)) {
+        removeFile(m_filePath);
+        m_entityTag.clear();
+        m_lastModified.clear();
+        return;
+    }
+
+    m_validatorUrl = validatorUrl;
+    m_offset = size;
+    m_bytesReceived = size;
+    m_expectedSize = expectedSize;
+
+    // Only the mirror the file has come from can confirm that it has not changed.
+    m_urls.move(m_urls.indexOf(validatorUrl), 0);
+}
+
+/*!
+  \internal
+  Passes received \a data on to the archive stream and the file. The file is written in large
+  blocks, since data arrives in small pieces.
+*/
+bool Download::writeData(const QByteArray &data)
+{
+    if (m_archiveStream) {
+        // Data saved by a previous download goes first.
+        if (m_offset > 0 && m_bytesReceived == m_offset)
+            m_archiveStream->writeFile(m_filePath, m_offset);
+
+        // Let the extraction catch up before reading more from the network.
+        if (!m_archiveStream->write(data) && !m_isReadingPaused) {
+            m_isReadingPaused = true;
+            m_stallTimer->stop();
+            m_reply->setReadBufferSize(PausedReadBufferSize);
+        }
+    }
+
+    if (!m_file)
+        return true;
+
+    m_fileBuffer += data;
+    if (m_fileBuffer.size() < FileBufferSize)
+        return true;
+
+    return flushFile();
+}
+
+bool Download::flushFile()
+{
+    if (m_fileBuffer.isEmpty())
+        return true;
+
+    const bool ok = m_file->write(m_fileBuffer) == m_fileBuffer.size();
+    m_fileBuffer.clear();
+    return ok;
+}
+
+void Download::saveMetadata() const
+{
+    QJsonObject jsonObject;
+    jsonObject[QStringLiteral("url")] = m_validatorUrl.toString();
+    jsonObject[QStringLiteral("size")] = static_cast<double>(m_expectedSize);
+
+    if (!m_entityTag.isEmpty())
+        jsonObject[QStringLiteral("etag")] = QString::fromLatin1(m_entityTag);
+
+    if (!m_lastModified.isEmpty())
+        jsonObject[QStringLiteral("last_modified")] = QString::fromLatin1(m_lastModified);
+
+    QFile file(m_filePath + QLatin1String(MetadataFileSuffix));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    file.write(QJsonDocument(jsonObject).toJson());
+}
+
+void Download::handleReadyRead()
+{
+    // Data is taken once the archive stream has room for it.
+    if (m_isReadingPaused || !prepareContent())
+        return;
+
+    QByteArray data = m_reply->readAll();
+    m_mirrorBytesReceived += data.size();
+
+    if (m_skipBytes > 0) {
+        const int skippedSize = static_cast<int>(qMin<qint64>(m_skipBytes, data.size()));
+        data.remove(0, skippedSize);
+        m_skipBytes -= skippedSize;
+    }
+
+    if (data.isEmpty())
+        return;
+
+    if (!writeData(data)) {
+        fail(QNetworkReply::UnknownContentError,
+             tr("Cannot write to %1: %2").arg(m_filePath, m_file->errorString()));
+        return;
+    }
+
+    m_bytesReceived += data.size();
+}
+
+void Download::handleFinished()
+{
+    if (m_isFinished)
+        return;
+
+    if (m_reply->error() != QNetworkReply::NoError) {
+        if (m_reply->error() != QNetworkReply::OperationCanceledError && failOver())
+            return;
+
+        // Range Not Satisfiable, the partial file is of no use.
+        if (m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 416)
+            removeFile(m_filePath);
+
+        finish(m_reply->error(), m_reply->errorString());
+        return;
+    }
+
+    QUrl redirectUrl = m_reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+    if (redirectUrl.isValid()) {
+        if (++m_redirectCount > MaxRedirects) {
+            finish(QNetworkReply::ProtocolFailure, tr("Too many redirects"));
+            return;
+        }
+
+        get(m_reply->url().resolved(redirectUrl));
+        return;
+    }
+
+    // Completed by resumeReading() once the rest of the data can be taken.
+    if (m_isReadingPaused)
+        return;
+
+    const QNetworkReply *reply = m_reply;
+    if (reply->bytesAvailable() > 0)
+        handleReadyRead();
+
+    // Writing may have failed, or the mirror has been abandoned.
+    if (m_isFinished || m_reply != reply)
+        return;
+
+    if (m_expectedSize != -1 && m_bytesReceived != m_expectedSize) {
+        // Do not resume from data that does not add up.
+        m_fileBuffer.clear();
+        if (m_file)
+            m_file->close();
+        removeFile(m_filePath);
+        finish(QNetworkReply::ProtocolFailure,
+               tr("Downloaded file has unexpected size: %1 bytes instead of %2.")
+               .arg(m_bytesReceived).arg(m_expectedSize));
+        return;
+    }
+
+    finish(QNetworkReply::NoError, QString());
+}
+
+/*!
+  \internal
+  Continues reading data received while the archive stream was full.
+*/
+void Download::resumeReading()
+{
+    if (!m_isReadingPaused || m_isFinished)
+        return;
+
+    m_isReadingPaused = false;
+    if (!m_reply)
+        return;
+
+    m_reply->setReadBufferSize(0);
+    m_stallTimer->start();
+
+    if (m_reply->bytesAvailable() > 0)
+        handleReadyRead();
+
+    // The reply may have finished in the meantime, unless reading has been paused again.
+    if (!m_isFinished && !m_isReadingPaused && m_reply->isFinished())
+        handleFinished();
+}
+
+void Download::handleStall()
+{
+    if (failOver())
+        return;
+
+    fail(QNetworkReply::TimeoutError, tr("Download has stalled"));
+}
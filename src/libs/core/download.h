@@ -0,0 +1,152 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_CORE_DOWNLOAD_H
+#define ZEAL_CORE_DOWNLOAD_H
+
+#include <QElapsedTimer>
+#include <QNetworkReply>
+#include <QObject>
+#include <QSharedPointer>
+#include <QUrl>
+
+class QFile;
+class QNetworkAccessManager;
+class QTimer;
+
+namespace Zeal {
+namespace Core {
+
+class ArchiveStream;
+class DownloadManager;
+class MirrorRanker;
+
+class Download : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority {
+        LowPriority,
+        NormalPriority,
+        HighPriority
+    };
+
+    ~Download() override;
+
+    QUrl url() const;
+    QList<QUrl> urls() const;
+    Priority priority() const;
+
+    QString filePath() const;
+    void setFilePath(const QString &filePath);
+    qint64 resumeOffset() const;
+
+    QSharedPointer<ArchiveStream> archiveStream() const;
+    void setArchiveStream(const QSharedPointer<ArchiveStream> &stream);
+
+    bool isRunning() const;
+    bool isFinished() const;
+
+    qint64 bytesReceived() const;
+    qint64 bytesTotal() const;
+
+    QNetworkReply::NetworkError error() const;
+    QString errorString() const;
+
+    static void removeFile(const QString &filePath);
+
+public slots:
+    void abort();
+
+signals:
+    void started();
+    void progress(qint64 received, qint64 total);
+    void finished();
+
+private:
+    friend class DownloadManager;
+
+    explicit Download(const QList<QUrl> &urls, Priority priority, DownloadManager *manager);
+
+    void start();
+    void get(const QUrl &url);
+    void finish(QNetworkReply::NetworkError error, QString errorString);
+    void fail(QNetworkReply::NetworkError error, const QString &errorString);
+    bool failOver();
+    void recordTransfer();
+    bool hasContent() const;
+    bool prepareContent();
+    bool writeData(const QByteArray &data);
+    bool flushFile();
+
+    void loadMetadata();
+    void saveMetadata() const;
+
+    void handleReadyRead();
+    void handleFinished();
+    void handleStall();
+    Q_INVOKABLE void resumeReading();
+
+    // Mirrors, in the order they are tried.
+    QList<QUrl> m_urls;
+    int m_urlIndex = 0;
+    int m_failoverCount = 0;
+    Priority m_priority;
+    MirrorRanker *m_mirrorRanker = nullptr;
+    QNetworkAccessManager *m_networkManager = nullptr;
+
+    QNetworkReply *m_reply = nullptr;
+    int m_redirectCount = 0;
+    bool m_isContentPrepared = false;
+    QSharedPointer<ArchiveStream> m_archiveStream;
+    // Set while the archive stream has too much data buffered, received data is left in the reply.
+    bool m_isReadingPaused = false;
+    QTimer *m_stallTimer = nullptr;
+    QElapsedTimer m_progressTimer;
+
+    // Data received from the current mirror, and already received data it resends.
+    qint64 m_mirrorBytesReceived = 0;
+    QElapsedTimer m_mirrorTimer;
+    qint64 m_skipBytes = 0;
+
+    // Partial download, resumed with a range request if validators match.
+    QString m_filePath;
+    QFile *m_file = nullptr;
+    QByteArray m_fileBuffer; // Received data not written to the file yet.
+    qint64 m_offset = 0;
+    qint64 m_expectedSize = -1;
+    QUrl m_validatorUrl;
+    QByteArray m_entityTag;
+    QByteArray m_lastModified;
+
+    qint64 m_bytesReceived = 0;
+    qint64 m_bytesTotal = -1;
+
+    bool m_isFinished = false;
+    QNetworkReply::NetworkError m_error = QNetworkReply::NoError;
+    QString m_errorString;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_DOWNLOAD_H
@@ -0,0 +1,262 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "downloadmanager.h"
+
+#include "mirrorranker.h"
+#include "networkaccessmanager.h"
+
+#include <QMutexLocker>
+#include <QPointer>
+#include <QTimer>
+
+using namespace Zeal::Core;
+
+namespace {
+const int DefaultMaxConcurrentDownloads = 3;
+const int ThroughputSampleInterval = 1000; // ms
+// Limits progress updates passed to the GUI thread.
+const int ProgressInterval = 100; // ms
+}
+
+/*!
+  \class Zeal::Core::DownloadManager
+  Queues downloads and runs them in the thread the manager belongs to, so that network replies
+  and disk writes do not compete with the GUI. Application moves the manager to a worker thread.
+  Its own network access manager is used, since QNetworkAccessManager cannot be shared between
+  threads.
+
+  download() and the statistics can be used from any thread, other members only from the thread
+  of the manager.
+*/
+DownloadManager::DownloadManager(QObject *parent) :
+    QObject(parent),
+    m_maxConcurrentDownloads(DefaultMaxConcurrentDownloads)
+{
+    m_networkManager = new NetworkAccessManager(this);
+    m_mirrorRanker = new MirrorRanker(m_networkManager, this);
+    connect(m_mirrorRanker, &MirrorRanker::probeFinished, this, &DownloadManager::startDownloads);
+}
+
+int DownloadManager::maxConcurrentDownloads() const
+{
+    return m_maxConcurrentDownloads;
+}
+
+void DownloadManager::setMaxConcurrentDownloads(int count)
+{
+    m_maxConcurrentDownloads = qMax(1, count);
+    startDownloads();
+}
+
+/*!
+  Makes new connections pick up changed proxy settings.
+*/
+void DownloadManager::clearAccessCache()
+{
+    m_networkManager->clearAccessCache();
+}
+
+QNetworkAccessManager *DownloadManager::networkManager() const
+{
+    return m_networkManager;
+}
+
+MirrorRanker *DownloadManager::mirrorRanker() const
+{
+    return m_mirrorRanker;
+}
+
+Download *DownloadManager::download(const QUrl &url, Download::Priority priority)
+{
+    return download(QList<QUrl>{url}, priority);
+}
+
+/*!
+  Queues download of a file available from mirror \a urls. Downloads with higher \a priority are
+  started first, downloads of the same priority are started in the order they have been requested.
+
+  Downloads are queued from the event loop of the calling thread, so that the returned download
+  can be set up first. It is moved to the thread of the manager then, and should be deleted with
+  deleteLater() once finished() is emitted.
+*/
+Download *DownloadManager::download(const QList<QUrl> &urls, Download::Priority priority)
+{
+    Q_ASSERT(!urls.isEmpty());
+
+    Download *download = new Download(urls, priority, this);
+
+    QTimer::singleShot(0, download, [this, download] {
+        download->moveToThread(thread());
+
+        const QPointer<Download> guard(download);
+        QTimer::singleShot(0, this, [this, guard] {
+            if (guard)
+                enqueue(guard);
+        });
+    });
+
+    return download;
+}
+
+/*!
+  Returns the number of bytes received by downloads requested since the queue has been empty.
+*/
+qint64 DownloadManager::bytesReceived() const
+{
+    QMutexLocker locker(&m_statisticsMutex);
+    return m_bytesReceived;
+}
+
+/*!
+  Returns the combined size of started downloads requested since the queue has been empty.
+*/
+qint64 DownloadManager::bytesTotal() const
+{
+    QMutexLocker locker(&m_statisticsMutex);
+    return m_bytesTotal;
+}
+
+/*!
+  Returns the recent combined download speed in bytes per second.
+*/
+qint64 DownloadManager::throughput() const
+{
+    QMutexLocker locker(&m_statisticsMutex);
+    return m_throughput;
+}
+
+/*!
+  Returns the estimated number of seconds until started downloads finish, or -1 if unknown.
+*/
+int DownloadManager::remainingTime() const
+{
+    QMutexLocker locker(&m_statisticsMutex);
+    if (m_throughput <= 0)
+        return -1;
+
+    return static_cast<int>((m_bytesTotal - m_bytesReceived) / m_throughput);
+}
+
+void DownloadManager::enqueue(Download *download)
+{
+    // Aborted before it could be queued.
+    if (download->isFinished())
+        return;
+
+    if (m_queue.isEmpty() && m_runningDownloads.isEmpty()) {
+        m_finishedBytesReceived = 0;
+        m_finishedBytesTotal = 0;
+        m_sampleTimer.invalidate();
+
+        QMutexLocker locker(&m_statisticsMutex);
+        m_throughput = 0;
+    }
+
+    // Owned by the manager until the requester deletes it.
+    download->setParent(this);
+
+    connect(download, &Download::progress, this, &DownloadManager::updateProgress);
+    connect(download, &Download::finished, this, [this, download] {
+        downloadFinished(download);
+    });
+
+    const Download::Priority priority = download->priority();
+    auto it = m_queue.begin();
+    while (it != m_queue.end() && (*it)->priority() >= priority)
+        ++it;
+    m_queue.insert(it, download);
+
+    // The download starts from the best mirror once they have responded.
+    if (download->urls().size() > 1)
+        m_mirrorRanker->probe(download->urls());
+
+    startDownloads();
+}
+
+void DownloadManager::startDownloads()
+{
+    auto it = m_queue.begin();
+    while (m_runningDownloads.size() < m_maxConcurrentDownloads && it != m_queue.end()) {
+        Download *download = *it;
+        if (m_mirrorRanker->isProbing(download->urls())) {
+            ++it;
+            continue;
+        }
+
+        it = m_queue.erase(it);
+        m_runningDownloads.append(download);
+        download->start();
+    }
+}
+
+void DownloadManager::updateProgress()
+{
+    updateStatistics();
+
+    if (m_progressTimer.isValid() && m_progressTimer.elapsed() < ProgressInterval)
+        return;
+
+    m_progressTimer.start();
+    emit progressChanged();
+}
+
+void DownloadManager::updateStatistics()
+{
+    qint64 received = m_finishedBytesReceived;
+    qint64 total = m_finishedBytesTotal;
+    for (const Download *download : m_runningDownloads) {
+        received += download->bytesReceived();
+        total += qMax(download->bytesTotal(), download->bytesReceived());
+    }
+
+    QMutexLocker locker(&m_statisticsMutex);
+    m_bytesReceived = received;
+    m_bytesTotal = total;
+
+    if (!m_sampleTimer.isValid()) {
+        m_sampleTimer.start();
+        m_sampleBytesReceived = received;
+    } else if (m_sampleTimer.elapsed() >= ThroughputSampleInterval) {
+        const qint64 rate = (received - m_sampleBytesReceived) * 1000 / m_sampleTimer.restart();
+        // Smooth out bursts.
+        m_throughput = m_throughput == 0 ? rate : (m_throughput * 3 + rate) / 4;
+        m_sampleBytesReceived = received;
+    }
+}
+
+void DownloadManager::downloadFinished(Download *download)
+{
+    if (m_queue.removeOne(download))
+        return;
+
+    if (!m_runningDownloads.removeOne(download))
+        return;
+
+    m_finishedBytesReceived += download->bytesReceived();
+    m_finishedBytesTotal += qMax(download->bytesTotal(), download->bytesReceived());
+
+    startDownloads();
+
+    updateStatistics();
+    emit progressChanged();
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_CORE_DOWNLOADMANAGER_H
+#define ZEAL_CORE_DOWNLOADMANAGER_H
+
+#include "download.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+
+class QNetworkAccessManager;
+
+namespace Zeal {
+namespace Core {
+
+class MirrorRanker;
+
+class DownloadManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DownloadManager(QObject *parent = nullptr);
+
+    int maxConcurrentDownloads() const;
+
+    QNetworkAccessManager *networkManager() const;
+    MirrorRanker *mirrorRanker() const;
+
+    Download *download(const QUrl &url, Download::Priority priority = Download::NormalPriority);
+    Download *download(const QList<QUrl> &urls,
+                       Download::Priority priority = Download::NormalPriority);
+
+    qint64 bytesReceived() const;
+    qint64 bytesTotal() const;
+    qint64 throughput() const;
+    int remainingTime() const;
+
+public slots:
+    void setMaxConcurrentDownloads(int count);
+    void clearAccessCache();
+
+signals:
+    void progressChanged();
+
+private:
+    void enqueue(Download *download);
+    void startDownloads();
+    void updateProgress();
+    void updateStatistics();
+    void downloadFinished(Download *download);
+
+    int m_maxConcurrentDownloads;
+    QNetworkAccessManager *m_networkManager = nullptr;
+    MirrorRanker *m_mirrorRanker = nullptr;
+
+    // Ordered by priority, then by the time downloads have been requested.
+    QList<Download *> m_queue;
+    QList<Download *> m_runningDownloads;
+
+    // Statistics of downloads requested since the queue has been empty.
+    qint64 m_finishedBytesReceived = 0;
+    qint64 m_finishedBytesTotal = 0;
+    QElapsedTimer m_sampleTimer;
+    qint64 m_sampleBytesReceived = 0;
+    QElapsedTimer m_progressTimer;
+
+    // Read from the GUI thread.
+    mutable QMutex m_statisticsMutex;
+    qint64 m_bytesReceived = 0;
+    qint64 m_bytesTotal = 0;
+    qint64 m_throughput = 0;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_DOWNLOADMANAGER_H
@@ -22,13 +22,261 @@
 
 #include "extractor.h"
 
+#include "archivestream.h"
+#include "contentstore.h"
+
+#include <util/packfile.h>
+#include <util/packwriter.h>
+
+#include <QCryptographicHash>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScopedPointer>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <QtConcurrent/QtConcurrent>
 
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <cerrno>
+#include <limits>
+
 using namespace Zeal::Core;
 
+namespace {
+const size_t ReadBlockSize = 1024 * 1024;
+const int ProgressInterval = 100; // ms
+// Bounds memory used by extracted files waiting to be written.
+const qint64 MaxPendingWriteSize = 64 * 1024 * 1024;
+// Larger files, or files of unknown size, are written while being decompressed.
+const qint64 MaxBufferedFileSize = 16 * 1024 * 1024;
+const int WriterThreadCount = 4;
+const char DocumentsPath[] = "Contents/Resources/Documents";
+
+struct StreamInfo {
+    ArchiveStream *stream;
+    QByteArray chunk; // Must stay valid until the next read.
+};
+
+la_ssize_t streamReadCallback(archive *archiveHandle, void *clientData, const void **buffer)
+{
+    StreamInfo *info = reinterpret_cast<StreamInfo *>(clientData);
+
+    info->chunk = info->stream->read();
+    if (info->stream->isAborted()) {
+        archive_set_error(archiveHandle, ECANCELED, "Download has been aborted");
+        return ARCHIVE_FATAL;
+    }
+
+    *buffer = info->chunk.constData();
+    return info->chunk.size();
+}
+
+QString archiveErrorString(archive *archiveHandle)
+{
+    return QString::fromLocal8Bit(archive_error_string(archiveHandle));
+}
+
+QString writeFile(const QString &filePath, const QByteArray &data)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        return QStringLiteral("Cannot write %1: %2").arg(filePath, file.errorString());
+
+    return QString();
+}
+
+// Writes extracted files on a pool of threads, so that decompression does not wait for file
+// creation. Docsets consist of many small files. Files that are already in the content
+// store, if any, are linked instead of written.
+class FileWriter
+{
+public:
+    explicit FileWriter(const QString &storagePath)
+    {
+        m_threadPool.setMaxThreadCount(WriterThreadCount);
+
+        if (!storagePath.isEmpty())
+            m_store.reset(new ContentStore(storagePath));
+    }
+
+    ~FileWriter()
+    {
+        m_threadPool.waitForDone();
+    }
+
+    void write(const QString &filePath, const QByteArray &data)
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pendingSize > 0 && m_pendingSize + data.size() > MaxPendingWriteSize)
+                m_written.wait(&m_mutex);
+            m_pendingSize += data.size();
+        }
+
+        QtConcurrent::run(&m_threadPool, [this, filePath, data] {
+            const QString errorString = m_store && ContentStore::isShareable(filePath)
+                    ? writeSharedFile(filePath, data) : writeFile(filePath, data);
+
+            QMutexLocker locker(&m_mutex);
+            m_pendingSize -= data.size();
+            if (m_errorString.isEmpty())
+                m_errorString = errorString;
+            m_written.wakeAll();
+        });
+    }
+
+    // Returns the first write error.
+    QString errorString() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_errorString;
+    }
+
+    QString waitForDone()
+    {
+        m_threadPool.waitForDone();
+        return errorString();
+    }
+
+    // Writes data of the current archive entry on the calling thread, block by block, for files
+    // that are too large to be held in memory.
+    QString writeEntry(const QString &filePath, archive *archiveHandle) const
+    {
+        const bool isShared = m_store && ContentStore::isShareable(filePath);
+
+        // Writing into an existing link would change the shared copy.
+        QFile::remove(filePath);
+
+        QFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly))
+            return QStringLiteral("Cannot write %1: %2").arg(filePath, file.errorString());
+
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        QByteArray buffer(static_cast<int>(ReadBlockSize), Qt::Uninitialized);
+        for (;;) {
+            const la_ssize_t size = archive_read_data(archiveHandle, buffer.data(), ReadBlockSize);
+            if (size == 0)
+                break;
+
+            if (size < 0)
+                return archiveErrorString(archiveHandle);
+
+            if (file.write(buffer.constData(), size) != size)
+                return QStringLiteral("Cannot write %1: %2").arg(filePath, file.errorString());
+
+            if (isShared)
+                hash.addData(buffer.constData(), static_cast<int>(size));
+        }
+
+        file.close();
+
+        if (isShared)
+            m_store->insert(hash.result().toHex(), filePath);
+
+        return QString();
+    }
+
+private:
+    QString writeSharedFile(const QString &filePath, const QByteArray &data) const
+    {
+        const QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex();
+
+        // Writing into an existing link would change the shared copy.
+        QFile::remove(filePath);
+
+        if (m_store->link(hash, filePath))
+            return QString();
+
+        const QString errorString = writeFile(filePath, data);
+        if (errorString.isEmpty())
+            m_store->insert(hash, filePath);
+
+        return errorString;
+    }
+
+    QScopedPointer<ContentStore> m_store;
+    QThreadPool m_threadPool;
+    mutable QMutex m_mutex;
+    QWaitCondition m_written;
+    qint64 m_pendingSize = 0;
+    QString m_errorString;
+};
+
+// Creates each directory once, instead of checking for it before every file.
+class DirectoryCache
+{
+public:
+    bool makePath(const QString &path)
+    {
+        if (m_paths.contains(path))
+            return true;
+
+        if (!QDir().mkpath(path))
+            return false;
+
+        QString parentPath = path;
+        while (!parentPath.isEmpty() && !m_paths.contains(parentPath)) {
+            m_paths.insert(parentPath);
+            parentPath.truncate(qMax(parentPath.lastIndexOf(QLatin1Char('/')), 0));
+        }
+
+        return true;
+    }
+
+private:
+    QSet<QString> m_paths;
+};
+
+// Returns the path of \a pathname inside of the docset documents directory, or an empty string.
+QString documentPath(const QString &pathname)
+{
+    const QString prefix = QLatin1String(DocumentsPath) + QLatin1Char('/');
+    return pathname.startsWith(prefix) ? pathname.mid(prefix.size()) : QString();
+}
+
+// Returns whether data of \a entry is small enough to be read into memory at once.
+bool isBufferable(archive_entry *entry)
+{
+    return archive_entry_size_is_set(entry) && archive_entry_size(entry) <= MaxBufferedFileSize;
+}
+
+QByteArray readEntryData(archive *archiveHandle, archive_entry *entry, QString *errorString)
+{
+    QByteArray data;
+    if (isBufferable(entry))
+        data.reserve(static_cast<int>(archive_entry_size(entry)));
+
+    char buffer[64 * 1024];
+    for (;;) {
+        const la_ssize_t size = archive_read_data(archiveHandle, buffer, sizeof(buffer));
+        if (size == 0)
+            break;
+
+        if (size < 0) {
+            *errorString = archiveErrorString(archiveHandle);
+            break;
+        }
+
+        if (data.size() > std::numeric_limits<int>::max() - size) {
+            *errorString = QStringLiteral("Entry %1 is too large")
+                    .arg(QString::fromUtf8(archive_entry_pathname(entry)));
+            break;
+        }
+
+        data.append(buffer, static_cast<int>(size));
+    }
+
+    return data;
+}
+}
+
 Extractor::Extractor(QObject *parent) :
     QObject(parent)
 {
@@ -36,33 +284,122 @@ Extractor::Extractor(QObject *parent) :
 
 void Extractor::extract(const QString &filePath, const QString &destination, const QString &root)
 {
-    ExtractInfo info = {
-        this, // extractor
-        archive_read_new(), // archiveHandle
-        filePath, // filePath
-        QFileInfo(filePath).size(), // totalBytes
-        0 // extractedBytes
-    };
-
-    archive_read_support_filter_all(info.archiveHandle);
-    archive_read_support_format_all(info.archiveHandle);
-
-    int r = archive_read_open_filename(info.archiveHandle, qPrintable(filePath), 10240);
+    archive *archiveHandle = archive_read_new();
+    archive_read_support_filter_all(archiveHandle);
+    archive_read_support_format_all(archiveHandle);
+
+    int r = archive_read_open_filename(archiveHandle, QFile::encodeName(filePath).constData(),
+                                       ReadBlockSize);
     if (r) {
-        emit error(filePath, QString::fromLocal8Bit(archive_error_string(info.archiveHandle)));
+        emit error(filePath, archiveErrorString(archiveHandle));
+        archive_read_free(archiveHandle);
         return;
     }
 
-    archive_read_extract_set_progress_callback(info.archiveHandle, &Extractor::progressCallback,
-                                               &info);
+    const qint64 totalBytes = QFileInfo(filePath).size();
+    const QString errorString = extractEntries(archiveHandle, destination, root, QString(), false,
+                                               [this, filePath, totalBytes](qint64 extracted) {
+        emit progress(filePath, extracted, totalBytes);
+    });
+
+    if (errorString.isEmpty())
+        emit completed(filePath);
+    else
+        emit error(filePath, errorString);
+
+    archive_read_free(archiveHandle);
+}
+
+/*!
+  Extracts an archive while it is being written into \a stream, blocking until the stream is
+  closed or aborted. Can be called from any thread. Unless \a storagePath is empty, docset files
+  are shared with other docsets through its ContentStore. If \a packDocuments is set, pages of
+  the docset are written into a single Util::PackFile instead of the documents directory.
+
+  Returns an error message, or an empty string on success.
+*/
+QString Extractor::extractStream(ArchiveStream *stream, const QString &destination,
+                                 const QString &root, const QString &storagePath,
+                                 bool packDocuments)
+{
+    StreamInfo info = {stream, QByteArray()};
+
+    archive *archiveHandle = archive_read_new();
+    archive_read_support_filter_all(archiveHandle);
+    archive_read_support_format_all(archiveHandle);
+
+    QString errorString;
+    if (archive_read_open(archiveHandle, &info, nullptr, &streamReadCallback, nullptr))
+        errorString = archiveErrorString(archiveHandle);
+    else
+        errorString = extractEntries(archiveHandle, destination, root, storagePath, packDocuments);
+
+    archive_read_free(archiveHandle);
+
+    // Wait for the rest of the download, so that it is complete once extraction is done.
+    if (errorString.isEmpty()) {
+        while (!stream->read().isEmpty()) {}
+
+        if (stream->isAborted())
+            errorString = QStringLiteral("Download has been aborted");
+    }
+
+    // Do not leave the writer waiting for an extraction that has failed. The stream is closed
+    // rather than aborted, which would make the failure look like a cancelled download.
+    if (!errorString.isEmpty())
+        stream->close();
+
+    return errorString;
+}
 
-    QDir destinationDir(destination);
+/*!
+  \internal
+  Decompresses entries on the calling thread, and leaves creation of regular files to a pool of
+  writer threads. Other entry types are rare in docsets, and are extracted by libarchive once all
+  pending files have been written. Calls \a progress with the number of bytes read from the
+  archive at most every 100 ms.
+
+  With \a packDocuments, entries of the documents directory are compressed into a pack file
+  on the calling thread, in archive order. Only the docset directory itself can be packed, so
+  \a root must be set.
+*/
+QString Extractor::extractEntries(archive *archiveHandle, const QString &destination,
+                                  const QString &root, const QString &storagePath,
+                                  bool packDocuments,
+                                  const std::function<void(qint64)> &progress)
+{
+    QString destinationPath = QDir(destination).absolutePath();
     if (!root.isEmpty())
-        destinationDir = destinationDir.filePath(root);
+        destinationPath += QLatin1Char('/') + root;
+
+    FileWriter writer(storagePath);
+    DirectoryCache directories;
+
+    QScopedPointer<Util::PackWriter> packWriter;
+    // Packed links whose targets have not been packed yet, by link path.
+    QHash<QString, QString> pendingLinks;
+    if (packDocuments && !root.isEmpty()) {
+        const QString packPath = destinationPath + QLatin1Char('/') + QLatin1String(DocumentsPath);
+        if (!directories.makePath(packPath.left(packPath.lastIndexOf(QLatin1Char('/')))))
+            return QStringLiteral("Cannot create directory for %1").arg(packPath);
+
+        packWriter.reset(new Util::PackWriter(Util::PackFile::packPath(packPath)));
+        if (!packWriter->open())
+            return packWriter->errorString();
+    }
+
+    QElapsedTimer progressTimer;
+    progressTimer.start();
 
     // TODO: Do not strip root directory in archive if it equals to 'root'
     archive_entry *entry;
-    while (archive_read_next_header(info.archiveHandle, &entry) == ARCHIVE_OK) {
+    for (;;) {
+        int r = archive_read_next_header(archiveHandle, &entry);
+        if (r == ARCHIVE_EOF)
+            break;
+        if (r < ARCHIVE_WARN)
+            return archiveErrorString(archiveHandle);
+
 #ifndef Q_OS_WIN32
         QString pathname = QString::fromUtf8(archive_entry_pathname(entry));
 #else
@@ -71,23 +408,156 @@ void Extractor::extract(const QString &filePath, const QString &destination, con
 #endif
         if (!root.isEmpty())
             pathname.remove(0, pathname.indexOf(QLatin1String("/")) + 1);
-        archive_entry_set_pathname(entry, qPrintable(destinationDir.filePath(pathname)));
-        archive_read_extract(info.archiveHandle, entry, 0);
+
+        // Keep entries inside of the destination.
+        if (pathname.isEmpty() || pathname.startsWith(QLatin1Char('/'))
+                || pathname.split(QLatin1Char('/')).contains(QLatin1String(".."))) {
+            continue;
+        }
+
+        if (pathname.endsWith(QLatin1Char('/')))
+            pathname.chop(1);
+
+        const QString path = destinationPath + QLatin1Char('/') + pathname;
+        const QString parentPath = path.left(path.lastIndexOf(QLatin1Char('/')));
+
+        if (packWriter && (pathname == QLatin1String(DocumentsPath)
+                           || !documentPath(pathname).isEmpty())) {
+            const QString errorString = packEntry(archiveHandle, entry, pathname, root,
+                                                  packWriter.data(), &pendingLinks);
+            if (!errorString.isEmpty())
+                return errorString;
+        } else if (archive_entry_filetype(entry) == AE_IFDIR) {
+            if (!directories.makePath(path))
+                return QStringLiteral("Cannot create directory %1").arg(path);
+        } else if (archive_entry_filetype(entry) == AE_IFREG && !archive_entry_hardlink(entry)) {
+            if (!directories.makePath(parentPath))
+                return QStringLiteral("Cannot create directory %1").arg(parentPath);
+
+            if (!isBufferable(entry)) {
+                const QString errorString = writer.writeEntry(path, archiveHandle);
+                if (!errorString.isEmpty())
+                    return errorString;
+            } else {
+                QString errorString;
+                const QByteArray data = readEntryData(archiveHandle, entry, &errorString);
+                if (!errorString.isEmpty())
+                    return errorString;
+
+                writer.write(path, data);
+            }
+        } else {
+            if (!directories.makePath(parentPath))
+                return QStringLiteral("Cannot create directory %1").arg(parentPath);
+
+            // Links may point to files that are still being written.
+            writer.waitForDone();
+
+            archive_entry_update_pathname_utf8(entry, path.toUtf8().constData());
+            if (archive_entry_hardlink(entry)) {
+                QString target = QString::fromUtf8(archive_entry_hardlink(entry));
+                if (!root.isEmpty())
+                    target.remove(0, target.indexOf(QLatin1String("/")) + 1);
+                archive_entry_update_hardlink_utf8(
+                            entry, (destinationPath + QLatin1Char('/') + target).toUtf8().constData());
+            }
+
+            r = archive_read_extract(archiveHandle, entry, ARCHIVE_EXTRACT_SECURE_NODOTDOT);
+            if (r == ARCHIVE_FATAL)
+                return archiveErrorString(archiveHandle);
+        }
+
+        const QString errorString = writer.errorString();
+        if (!errorString.isEmpty())
+            return errorString;
+
+        if (progress && progressTimer.elapsed() >= ProgressInterval) {
+            progress(archive_filter_bytes(archiveHandle, -1));
+            progressTimer.restart();
+        }
+    }
+
+    const QString errorString = writer.waitForDone();
+    if (!errorString.isEmpty())
+        return errorString;
+
+    if (packWriter) {
+        // Links can come before their targets in the archive, or point to other links.
+        bool isResolving = true;
+        while (isResolving && !pendingLinks.isEmpty()) {
+            isResolving = false;
+            for (auto it = pendingLinks.begin(); it != pendingLinks.end();) {
+                if (packWriter->addLink(it.key(), it.value())) {
+                    it = pendingLinks.erase(it);
+                    isResolving = true;
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        if (!pendingLinks.isEmpty()) {
+            return QStringLiteral("Cannot pack link %1, its target %2 is not a packed file")
+                    .arg(pendingLinks.cbegin().key(), pendingLinks.cbegin().value());
+        }
+
+        if (!packWriter->close())
+            return packWriter->errorString();
     }
 
-    emit completed(filePath);
-    archive_read_free(info.archiveHandle);
+    if (progress)
+        progress(archive_filter_bytes(archiveHandle, -1));
+
+    return QString();
 }
 
-void Extractor::progressCallback(void *ptr)
+/*!
+  \internal
+  Adds an entry of the documents directory at \a pathname to \a packWriter. Directories are
+  implied by file paths, and links are stored as aliases of packed files. Links to files that
+  have not been packed yet are added to \a pendingLinks.
+*/
+QString Extractor::packEntry(archive *archiveHandle, archive_entry *entry, const QString &pathname,
+                             const QString &root, Util::PackWriter *packWriter,
+                             QHash<QString, QString> *pendingLinks)
 {
-    ExtractInfo *info = reinterpret_cast<ExtractInfo *>(ptr);
+    const QString path = documentPath(pathname);
+    if (path.isEmpty())
+        return QString();
 
-    const qint64 extractedBytes = archive_filter_bytes(info->archiveHandle, -1);
-    if (extractedBytes == info->extractedBytes)
-        return;
+    switch (archive_entry_filetype(entry)) {
+    case AE_IFREG:
+        if (archive_entry_hardlink(entry)) {
+            QString target = QString::fromUtf8(archive_entry_hardlink(entry));
+            if (!root.isEmpty())
+                target.remove(0, target.indexOf(QLatin1String("/")) + 1);
 
-    info->extractedBytes = extractedBytes;
+            const QString targetPath = documentPath(target);
+            if (!packWriter->addLink(path, targetPath))
+                pendingLinks->insert(path, targetPath.isEmpty() ? target : targetPath);
+        } else {
+            QString errorString;
+            const QByteArray data = readEntryData(archiveHandle, entry, &errorString);
+            if (!errorString.isEmpty())
+                return errorString;
+
+            if (!packWriter->add(path, data))
+                return packWriter->errorString();
+        }
+        break;
+    case AE_IFLNK: {
+        const QString target = QString::fromUtf8(archive_entry_symlink(entry));
+        const int slashPosition = path.lastIndexOf(QLatin1Char('/'));
+        const QString basePath = slashPosition == -1 ? QString() : path.left(slashPosition + 1);
+        const QString targetPath = target.startsWith(QLatin1Char('/'))
+                ? target : QDir::cleanPath(basePath + target);
+        if (!packWriter->addLink(path, targetPath))
+            pendingLinks->insert(path, targetPath);
+        break;
+    }
+    default:
+        break;
+    }
 
-    emit info->extractor->progress(info->filePath, extractedBytes, info->totalBytes);
+    return QString();
 }
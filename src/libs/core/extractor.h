@@ -23,19 +23,35 @@
 #ifndef EXTRACTOR_H
 #define EXTRACTOR_H
 
+#include <QHash>
 #include <QObject>
 
+#include <functional>
+
 struct archive;
+struct archive_entry;
 
 namespace Zeal {
+
+namespace Util {
+class PackWriter;
+}
+
 namespace Core {
 
+class ArchiveStream;
+
 class Extractor : public QObject
 {
     Q_OBJECT
 public:
     explicit Extractor(QObject *parent = nullptr);
 
+    static QString extractStream(ArchiveStream *stream, const QString &destination,
+                                 const QString &root = QString(),
+                                 const QString &storagePath = QString(),
+                                 bool packDocuments = false);
+
 public slots:
     void extract(const QString &filePath, const QString &destination, const QString &root = QString());
 
@@ -45,15 +61,13 @@ signals:
     void progress(const QString &filePath, qint64 extracted, qint64 total);
 
 private:
-    struct ExtractInfo {
-        Extractor *extractor;
-        archive *archiveHandle;
-        QString filePath;
-        qint64 totalBytes;
-        qint64 extractedBytes;
-    };
-
-    static void progressCallback(void *ptr);
+    static QString extractEntries(archive *archiveHandle, const QString &destination,
+                                  const QString &root, const QString &storagePath,
+                                  bool packDocuments,
+                                  const std::function<void(qint64)> &progress = nullptr);
+    static QString packEntry(archive *archiveHandle, archive_entry *entry, const QString &pathname,
+                             const QString &root, Util::PackWriter *packWriter,
+                             QHash<QString, QString> *pendingLinks);
 };
 
 } // namespace Core
@@ -0,0 +1,184 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "mirrorranker.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+
+#include <algorithm>
+
+using namespace Zeal::Core;
+
+namespace {
+const int ProbeTimeout = 3000; // ms
+const qint64 ProbeInterval = 10 * 60 * 1000; // ms
+// Shorter transfers are dominated by latency.
+const qint64 MinTransferDuration = 1000; // ms
+}
+
+/*!
+  Creates a ranker sending probes through \a networkManager.
+*/
+MirrorRanker::MirrorRanker(QNetworkAccessManager *networkManager, QObject *parent) :
+    QObject(parent),
+    m_networkManager(networkManager)
+{
+}
+
+/*!
+  Returns \a urls ordered from the most to the least preferred mirror. Mirrors are ranked by
+  throughput measured during previous downloads, then by probe latency. Mirrors that have failed
+  recently go last, and unknown mirrors keep their relative order.
+*/
+QList<QUrl> MirrorRanker::rank(const QList<QUrl> &urls) const
+{
+    QList<QUrl> rankedUrls = urls;
+
+    std::stable_sort(rankedUrls.begin(), rankedUrls.end(), [this](const QUrl &a, const QUrl &b) {
+        const Mirror ma = m_mirrors.value(mirrorKey(a));
+        const Mirror mb = m_mirrors.value(mirrorKey(b));
+
+        if (ma.hasFailed != mb.hasFailed)
+            return mb.hasFailed;
+
+        if (ma.throughput != mb.throughput)
+            return ma.throughput > mb.throughput;
+
+        if (ma.latency != mb.latency)
+            return ma.latency != -1 && (mb.latency == -1 || ma.latency < mb.latency);
+
+        return false;
+    });
+
+    return rankedUrls;
+}
+
+/*!
+  Sends HEAD requests to mirrors of \a urls, unless they have been probed recently.
+  Emits probeFinished() after each probe.
+*/
+void MirrorRanker::probe(const QList<QUrl> &urls)
+{
+    for (const QUrl &url : urls) {
+        const QString key = mirrorKey(url);
+        Mirror &mirror = m_mirrors[key];
+
+        if (mirror.probeReply)
+            continue;
+
+        if (mirror.probeTimer.isValid() && mirror.probeTimer.elapsed() < ProbeInterval)
+            continue;
+
+        QNetworkReply *reply = m_networkManager->head(QNetworkRequest(url));
+        mirror.probeReply = reply;
+        mirror.probeTimer.start();
+
+        connect(reply, &QNetworkReply::finished, this, [this, key, reply] {
+            handleProbeFinished(key, reply);
+        });
+        QTimer::singleShot(ProbeTimeout, reply, &QNetworkReply::abort);
+    }
+}
+
+/*!
+  Returns \c true if any of mirrors of \a urls is still being probed.
+*/
+bool MirrorRanker::isProbing(const QList<QUrl> &urls) const
+{
+    for (const QUrl &url : urls) {
+        if (m_mirrors.value(mirrorKey(url)).probeReply)
+            return true;
+    }
+
+    return false;
+}
+
+/*!
+  Returns round trip time of the last probe of \a url mirror in milliseconds, or -1 if unknown.
+*/
+qint64 MirrorRanker::latency(const QUrl &url) const
+{
+    return m_mirrors.value(mirrorKey(url)).latency;
+}
+
+/*!
+  Returns download speed from \a url mirror in bytes per second, or -1 if unknown.
+*/
+qint64 MirrorRanker::throughput(const QUrl &url) const
+{
+    return m_mirrors.value(mirrorKey(url)).throughput;
+}
+
+/*!
+  Records that \a bytes have been downloaded from \a url mirror in \a msecs.
+*/
+void MirrorRanker::recordTransfer(const QUrl &url, qint64 bytes, qint64 msecs)
+{
+    if (msecs < MinTransferDuration)
+        return;
+
+    Mirror &mirror = m_mirrors[mirrorKey(url)];
+    const qint64 rate = bytes * 1000 / msecs;
+    // Smooth out single measurements.
+    mirror.throughput = mirror.throughput == -1 ? rate : (mirror.throughput + rate) / 2;
+    mirror.hasFailed = false;
+}
+
+/*!
+  Records that download from \a url mirror has failed or stalled. The mirror is ranked last
+  until it succeeds again.
+*/
+void MirrorRanker::recordFailure(const QUrl &url)
+{
+    m_mirrors[mirrorKey(url)].hasFailed = true;
+}
+
+void MirrorRanker::handleProbeFinished(const QString &key, QNetworkReply *reply)
+{
+    reply->deleteLater();
+
+    Mirror &mirror = m_mirrors[key];
+    mirror.probeReply = nullptr;
+
+    // Redirects are fine, the mirror is responding.
+    const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (reply->error() != QNetworkReply::NoError || statusCode >= 400) {
+        mirror.latency = -1;
+        mirror.hasFailed = true;
+    } else {
+        mirror.latency = mirror.probeTimer.elapsed();
+        mirror.hasFailed = false;
+    }
+
+    emit probeFinished();
+}
+
+// Mirrors are told apart by their origin, a host serves all files at the same speed.
+QString MirrorRanker::mirrorKey(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment
+                        | QUrl::RemoveUserInfo).toString();
+}
@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef ZEAL_CORE_MIRRORRANKER_H
+#define ZEAL_CORE_MIRRORRANKER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+namespace Zeal {
+namespace Core {
+
+// Orders mirrors of a file by measured download speed and probe latency.
+class MirrorRanker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MirrorRanker(QNetworkAccessManager *networkManager, QObject *parent = nullptr);
+
+    QList<QUrl> rank(const QList<QUrl> &urls) const;
+
+    void probe(const QList<QUrl> &urls);
+    bool isProbing(const QList<QUrl> &urls) const;
+
+    qint64 latency(const QUrl &url) const;
+    qint64 throughput(const QUrl &url) const;
+
+    void recordTransfer(const QUrl &url, qint64 bytes, qint64 msecs);
+    void recordFailure(const QUrl &url);
+
+signals:
+    void probeFinished();
+
+private:
+    struct Mirror {
+        qint64 latency = -1; // ms
+        qint64 throughput = -1; // bytes per second
+        bool hasFailed = false;
+        QElapsedTimer probeTimer;
+        QNetworkReply *probeReply = nullptr;
+    };
+
+    void handleProbeFinished(const QString &key, QNetworkReply *reply);
+
+    static QString mirrorKey(const QUrl &url);
+
+    QNetworkAccessManager *m_networkManager = nullptr;
+    QHash<QString, Mirror> m_mirrors;
+};
+
+} // namespace Core
+} // namespace Zeal
+
+#endif // ZEAL_CORE_MIRRORRANKER_H
@@ -22,10 +22,99 @@
 
 #include "networkaccessmanager.h"
 
+#include <util/packfile.h>
+
+#include <QMimeDatabase>
 #include <QNetworkRequest>
+#include <QTimer>
 
+using namespace Zeal;
 using namespace Zeal::Core;
 
+namespace {
+const char DocumentsDirectory[] = "/Contents/Resources/Documents";
+
+// Serves a docset page from the pack replacing the documents directory.
+class PackReply : public QNetworkReply
+{
+public:
+    explicit PackReply(const QNetworkRequest &request, QObject *parent = nullptr) :
+        QNetworkReply(parent)
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(QNetworkAccessManager::GetOperation);
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+        QUrl fileUrl = request.url();
+        fileUrl.setScheme(QStringLiteral("file"));
+        const QString filePath = fileUrl.toLocalFile();
+
+        bool ok = false;
+        const int index = filePath.indexOf(QLatin1String(DocumentsDirectory));
+        if (index != -1) {
+            const int documentPathSize = index + static_cast<int>(sizeof(DocumentsDirectory)) - 1;
+            const QSharedPointer<Util::PackFile> pack
+                    = Util::PackFile::open(Util::PackFile::packPath(filePath.left(documentPathSize)));
+            if (pack)
+                m_data = pack->read(filePath.mid(documentPathSize + 1), &ok);
+        }
+
+        if (!ok) {
+            setError(ContentNotFoundError, QStringLiteral("Cannot open %1").arg(filePath));
+            QTimer::singleShot(0, this, [this] {
+                emit error(ContentNotFoundError);
+                emit finished();
+            });
+            return;
+        }
+
+        const QMimeType mimeType
+                = QMimeDatabase().mimeTypeForFile(filePath, QMimeDatabase::MatchExtension);
+        setHeader(QNetworkRequest::ContentTypeHeader, mimeType.name());
+        setHeader(QNetworkRequest::ContentLengthHeader, m_data.size());
+
+        QTimer::singleShot(0, this, [this] {
+            emit metaDataChanged();
+            emit downloadProgress(m_data.size(), m_data.size());
+            emit readyRead();
+            emit finished();
+        });
+    }
+
+    void abort() override
+    {
+        close();
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        if (m_offset >= m_data.size())
+            return -1;
+
+        const qint64 size = qMin(maxSize, m_data.size() - m_offset);
+        memcpy(data, m_data.constData() + m_offset, static_cast<size_t>(size));
+        m_offset += size;
+        return size;
+    }
+
+private:
+    QByteArray m_data;
+    qint64 m_offset = 0;
+};
+}
+
 NetworkAccessManager::NetworkAccessManager(QObject *parent)
     : QNetworkAccessManager(parent)
 {
@@ -39,6 +128,9 @@ QNetworkReply *NetworkAccessManager::createRequest(QNetworkAccessManager::Operat
 
     const QUrl url = request.url();
 
+    if (url.scheme() == Util::PackFile::urlScheme())
+        return new PackReply(request, this);
+
     // Forward all non-local schemaless URLs via HTTPS.
     if (localSchemes.contains(url.scheme()) && !url.host().isEmpty()) {
         QUrl overrideUrl(url);
@@ -74,6 +74,8 @@ void Settings::load()
 
     settings->beginGroup(GroupTabs);
     openNewTabAfterActive = settings->value(QStringLiteral("open_new_tab_after_active"), false).toBool();
+    maxLoadedTabs = settings->value(QStringLiteral("max_loaded_tabs"), 10).toInt();
+    tabUnloadTimeout = settings->value(QStringLiteral("unload_timeout"), 30).toInt();
     settings->endGroup();
 
     settings->beginGroup(GroupSearch);
@@ -113,6 +115,9 @@ void Settings::load()
 #endif
         QDir().mkpath(docsetPath);
     }
+    maxConcurrentDownloads = settings->value(QStringLiteral("max_concurrent_downloads"), 3).toInt();
+    deduplicateDocsetFiles = settings->value(QStringLiteral("deduplicate_files"), false).toBool();
+    packDocsetDocuments = settings->value(QStringLiteral("pack_documents"), false).toBool();
     settings->endGroup();
 
     settings->beginGroup(GroupState);
@@ -146,6 +151,8 @@ void Settings::save()
 
     settings->beginGroup(GroupTabs);
     settings->setValue(QStringLiteral("open_new_tab_after_active"), openNewTabAfterActive);
+    settings->setValue(QStringLiteral("max_loaded_tabs"), maxLoadedTabs);
+    settings->setValue(QStringLiteral("unload_timeout"), tabUnloadTimeout);
     settings->endGroup();
 
     settings->beginGroup(GroupSearch);
@@ -171,6 +178,9 @@ void Settings::save()
 
     settings->beginGroup(GroupDocsets);
     settings->setValue(QStringLiteral("path"), docsetPath);
+    settings->setValue(QStringLiteral("max_concurrent_downloads"), maxConcurrentDownloads);
+    settings->setValue(QStringLiteral("deduplicate_files"), deduplicateDocsetFiles);
+    settings->setValue(QStringLiteral("pack_documents"), packDocsetDocuments);
     settings->endGroup();
 
     settings->beginGroup(GroupState);
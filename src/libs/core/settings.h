@@ -55,6 +55,9 @@ public:
 
     // Tabs Behavior
     bool openNewTabAfterActive;
+    // Background tabs are unloaded to save memory, 0 disables the limit.
+    int maxLoadedTabs;
+    int tabUnloadTimeout; // In minutes.
 
     // Search
     bool fuzzySearchEnabled;
@@ -93,6 +96,11 @@ public:
 
     // Other
     QString docsetPath;
+    int maxConcurrentDownloads;
+    // Identical docset files are stored once, see ContentStore.
+    bool deduplicateDocsetFiles;
+    // Docset pages are stored in a compressed pack, see Util::PackFile.
+    bool packDocsetDocuments;
 
     // State
     QByteArray windowGeometry;
@@ -26,14 +26,17 @@
 #include "cancellationtoken.h"
 #include "searchresult.h"
 
+#include <util/packfile.h>
 #include <util/plist.h>
 #include <util/sqlitedatabase.h>
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutexLocker>
 #include <QRegularExpression>
 #include <QVariant>
 #include <QVarLengthArray>
@@ -48,6 +51,15 @@ namespace {
 const char IndexNamePrefix[] = "__zi_name"; // zi - Zeal index
 const char IndexNameVersion[] = "0001"; // Current index version
 
+// Flat copy of ZDash tables, see Docset::createView().
+const char SearchTableName[] = "__zi_search0001";
+// Symbols by page, used to build TOC.
+const char TocTableName[] = "__zi_toc0001";
+// Key-value storage for Zeal data.
+const char MetaTableName[] = "__zi_meta";
+
+const int RelatedLinksCacheSize = 100; // Number of pages
+
 namespace InfoPlist {
 const char CFBundleName[] = "CFBundleName";
 //const char CFBundleIdentifier[] = "CFBundleIdentifier";
@@ -62,14 +74,25 @@ const char DocSetPlatformFamily[] = "DocSetPlatformFamily";
 }
 
 static void sqliteScoreFunction(sqlite3_context *context, int argc, sqlite3_value **argv);
+static void sqlitePagePathFunction(sqlite3_context *context, int argc, sqlite3_value **argv);
+static void sqlitePageFragmentFunction(sqlite3_context *context, int argc, sqlite3_value **argv);
+static int scoreFunction(const char *needleOrig, const char *haystackOrig,
+                         int *matchStart = nullptr, int *matchLength = nullptr);
+static QVector<QPair<int, int>> matchSpans(const QString &query, const QString &name, bool fuzzy);
 
 Docset::Docset(const QString &path) :
-    m_path(path)
+    m_path(path),
+    m_documentPath(QDir(path).filePath(QStringLiteral("Contents/Resources/Documents"))),
+    m_relatedLinksCache(RelatedLinksCacheSize)
 {
     QDir dir(m_path);
     if (!dir.exists())
         return;
 
+    // Documents can also be kept in a pack, see Util::PackFile.
+    if (!QFileInfo(m_documentPath).isDir())
+        m_documentPack = Util::PackFile::open(Util::PackFile::packPath(m_documentPath));
+
     loadMetadata();
 
     // Attempt to find the icon in any supported format
@@ -140,34 +163,25 @@ Docset::Docset(const QString &path) :
         createView();
     }
 
-    if (!dir.cd(QStringLiteral("Documents"))) {
+    createTocTable();
+
+    if (!dir.cd(QStringLiteral("Documents")) && !m_documentPack) {
         m_type = Type::Invalid;
         return;
     }
 
     // Setup keywords
-    if (plist.contains(InfoPlist::DocSetPlatformFamily))
-        m_keywords << plist[InfoPlist::DocSetPlatformFamily].toString();
-
-    if (plist.contains(InfoPlist::DashDocSetPluginKeyword))
-        m_keywords << plist[InfoPlist::DashDocSetPluginKeyword].toString();
-
-    if (plist.contains(InfoPlist::DashDocSetKeyword))
-        m_keywords << plist[InfoPlist::DashDocSetKeyword].toString();
-
-    if (plist.contains(InfoPlist::DashDocSetFamily)) {
-        const QString kw = plist[InfoPlist::DashDocSetFamily].toString();
-        if (kw != QLatin1String("dashtoc") && kw != QLatin1String("unsorteddashtoc"))
-            m_keywords << kw;
-    }
-
+    m_keywords << plistKeywords(plist);
     m_keywords.removeDuplicates();
 
     // Prefer index path provided by the docset over metadata.
     if (plist.contains(InfoPlist::DashIndexFilePath)) {
         m_indexFileUrl = createPageUrl(plist[InfoPlist::DashIndexFilePath].toString());
     } else if (m_indexFileUrl.isEmpty()) {
-        if (dir.exists(QStringLiteral("index.html")))
+        const bool hasIndexFile = m_documentPack
+                ? m_documentPack->contains(QStringLiteral("index.html"))
+                : dir.exists(QStringLiteral("index.html"));
+        if (hasIndexFile)
             m_indexFileUrl = createPageUrl(QStringLiteral("index.html"));
         else
             qWarning("Cannot determine index file for docset %s", qPrintable(m_name));
@@ -178,6 +192,8 @@ Docset::Docset(const QString &path) :
 
 Docset::~Docset()
 {
+    // Wait for a query running in another thread.
+    QMutexLocker locker(&m_dbMutex);
     delete m_db;
 }
 
@@ -218,7 +234,7 @@ QString Docset::path() const
 
 QString Docset::documentPath() const
 {
-    return QDir(m_path).filePath(QStringLiteral("Contents/Resources/Documents"));
+    return m_documentPath;
 }
 
 QIcon Docset::icon() const
@@ -259,7 +275,7 @@ const QMap<QString, QUrl> &Docset::symbols(const QString &symbolType) const
 QList<SearchResult> Docset::search(const QString &query, const CancellationToken &token) const
 {
     QString sql;
-    if (m_type == Docset::Type::Dash) {
+    if (m_type == Docset::Type::Dash && !m_hasTocTable) {
         if (m_fuzzySearchEnabled) {
             sql = QStringLiteral("SELECT name, type, path, '', zealScore('%1', name) as score"
                                  "  FROM searchIndex"
@@ -271,14 +287,16 @@ QList<SearchResult> Docset::search(const QString &query, const CancellationToken
         }
     } else {
         if (m_fuzzySearchEnabled) {
-            sql = QStringLiteral("SELECT name, type, path, fragment, zealScore('%1', name) as score"
-                                 "  FROM searchIndex"
+            sql = QStringLiteral("SELECT name, type, path, fragment, zealScore('%2', name) as score"
+                                 "  FROM %1"
                                  "  WHERE score > 0");
         } else {
             sql = QStringLiteral("SELECT name, type, path, fragment"
-                                 "  FROM searchIndex"
-                                 "  WHERE (name LIKE '%%1%' ESCAPE '\\')");
+                                 "  FROM %1"
+                                 "  WHERE (name LIKE '%%2%' ESCAPE '\\')");
         }
+
+        sql = sql.arg(symbolTableName());
     }
 
     // Limit for very short queries.
@@ -290,59 +308,82 @@ QList<SearchResult> Docset::search(const QString &query, const CancellationToken
     // Make it safe to use in a SQL query.
     QString sanitizedQuery = query;
     sanitizedQuery.replace(QLatin1Char('\''), QLatin1String("''"));
+    QMutexLocker locker(&m_dbMutex);
     m_db->prepare(sql.arg(sanitizedQuery));
 
     QList<SearchResult> results;
     while (m_db->next() && !token.isCanceled()) {
-        results.append({m_db->value(0).toString(),
+        const QString name = m_db->value(0).toString();
+        results.append({name,
                         parseSymbolType(m_db->value(1).toString()),
                         m_db->value(2).toString(), m_db->value(3).toString(),
-                        const_cast<Docset *>(this), m_db->value(4).toInt()});
+                        const_cast<Docset *>(this), m_db->value(4).toInt(),
+                        matchSpans(query, name, m_fuzzySearchEnabled)});
     }
 
     return results;
 }
 
+/*!
+  Returns symbols found on the page at \a url. Results are cached, so repeated calls for the same
+  page do not query the index. This function is thread-safe.
+*/
 QList<SearchResult> Docset::relatedLinks(const QUrl &url) const
 {
-    QList<SearchResult> results;
+    const QString path = pagePath(url);
 
-    // Strip docset path and anchor from url
-    const QString dir = documentPath();
-    QString urlPath = url.path();
-    int dirPosition = urlPath.indexOf(dir);
-    QString path = url.path().mid(dirPosition + dir.size() + 1);
+    {
+        QMutexLocker locker(&m_relatedLinksCacheMutex);
+        if (const QList<SearchResult> *results = m_relatedLinksCache.object(path))
+            return *results;
+    }
 
-    // Get the url without the #anchor.
-    QUrl cleanUrl(path);
-    cleanUrl.setFragment(QString());
+    QList<SearchResult> results;
 
     // Prepare the query to look up all pages with the same url.
     QString sql;
-    if (m_type == Docset::Type::Dash) {
+    if (m_hasTocTable) {
+        sql = QStringLiteral("SELECT name, type, path, fragment"
+                             "  FROM %1"
+                             "  WHERE path = '%2' AND fragment <> ''"
+                             "  ORDER BY rowid")
+                .arg(TocTableName, QString(path).replace(QLatin1Char('\''), QLatin1String("''")));
+    } else if (m_type == Docset::Type::Dash) {
         sql = QStringLiteral("SELECT name, type, path"
                              "  FROM searchIndex"
-                             "  WHERE path LIKE \"%1%%\" AND path <> \"%1\"");
+                             "  WHERE path LIKE \"%1%%\" AND path <> \"%1\"").arg(path);
     } else if (m_type == Docset::Type::ZDash) {
         sql = QStringLiteral("SELECT name, type, path, fragment"
                              "  FROM searchIndex"
-                             "  WHERE path = \"%1\" AND fragment IS NOT NULL");
+                             "  WHERE path = \"%1\" AND fragment IS NOT NULL").arg(path);
     }
 
-    m_db->prepare(sql.arg(cleanUrl.toString()));
-    while (m_db->next()) {
-        results.append({m_db->value(0).toString(),
-                        parseSymbolType(m_db->value(1).toString()),
-                        m_db->value(2).toString(), m_db->value(3).toString(),
-                        const_cast<Docset *>(this), 0});
+    {
+        QMutexLocker locker(&m_dbMutex);
+        m_db->prepare(sql);
+        while (m_db->next()) {
+            results.append({m_db->value(0).toString(),
+                            parseSymbolType(m_db->value(1).toString()),
+                            m_db->value(2).toString(), m_db->value(3).toString(),
+                            const_cast<Docset *>(this), 0});
+        }
     }
 
     if (results.size() == 1)
         results.clear();
 
+    QMutexLocker locker(&m_relatedLinksCacheMutex);
+    m_relatedLinksCache.insert(path, new QList<SearchResult>(results));
+
     return results;
 }
 
+bool Docset::hasCachedRelatedLinks(const QUrl &url) const
+{
+    QMutexLocker locker(&m_relatedLinksCacheMutex);
+    return m_relatedLinksCache.contains(pagePath(url));
+}
+
 QUrl Docset::searchResultUrl(const SearchResult &result) const
 {
     return createPageUrl(result.urlPath, result.urlFragment);
@@ -385,6 +426,52 @@ void Docset::loadMetadata()
     }
 }
 
+/*!
+  Returns keywords declared in Info.plist of the docset at \a path, without loading the docset.
+  Unlike keywords(), the result does not include keywords from the docset metadata.
+*/
+QStringList Docset::plistKeywords(const QString &path)
+{
+    const QDir dir(path + QLatin1String("/Contents"));
+
+    Util::Plist plist;
+    if (dir.exists(QStringLiteral("Info.plist")))
+        plist.read(dir.filePath(QStringLiteral("Info.plist")));
+    else if (dir.exists(QStringLiteral("info.plist")))
+        plist.read(dir.filePath(QStringLiteral("info.plist")));
+    else
+        return {};
+
+    if (plist.hasError())
+        return {};
+
+    QStringList list = plistKeywords(plist);
+    list.removeDuplicates();
+    return list;
+}
+
+QStringList Docset::plistKeywords(const Util::Plist &plist)
+{
+    QStringList list;
+
+    if (plist.contains(InfoPlist::DocSetPlatformFamily))
+        list << plist[InfoPlist::DocSetPlatformFamily].toString();
+
+    if (plist.contains(InfoPlist::DashDocSetPluginKeyword))
+        list << plist[InfoPlist::DashDocSetPluginKeyword].toString();
+
+    if (plist.contains(InfoPlist::DashDocSetKeyword))
+        list << plist[InfoPlist::DashDocSetKeyword].toString();
+
+    if (plist.contains(InfoPlist::DashDocSetFamily)) {
+        const QString kw = plist[InfoPlist::DashDocSetFamily].toString();
+        if (kw != QLatin1String("dashtoc") && kw != QLatin1String("unsorteddashtoc"))
+            list << kw;
+    }
+
+    return list;
+}
+
 void Docset::countSymbols()
 {
     static const QString sql = QStringLiteral("SELECT type, COUNT(*)"
@@ -413,18 +500,19 @@ void Docset::loadSymbols(const QString &symbolType) const
 void Docset::loadSymbols(const QString &symbolType, const QString &symbolString) const
 {
     QString sql;
-    if (m_type == Docset::Type::Dash) {
+    if (m_type == Docset::Type::Dash && !m_hasTocTable) {
         sql = QStringLiteral("SELECT name, path"
                              "  FROM searchIndex"
                              "  WHERE type='%1'"
                              "  ORDER BY name");
     } else {
         sql = QStringLiteral("SELECT name, path, fragment"
-                             "  FROM searchIndex"
-                             "  WHERE type='%1'"
-                             "  ORDER BY name");
+                             "  FROM %1"
+                             "  WHERE type='%2'"
+                             "  ORDER BY name").arg(symbolTableName());
     }
 
+    QMutexLocker locker(&m_dbMutex);
     if (!m_db->prepare(sql.arg(symbolString))) {
         qWarning("SQL Error: %s", qPrintable(m_db->lastError()));
         return;
@@ -470,11 +558,16 @@ void Docset::createIndex()
     m_db->execute(indexCreateQuery.arg(IndexNamePrefix, IndexNameVersion, tableName, columnName));
 }
 
+/*!
+  \internal
+  Materializes Core Data tables of a ZDash docset into a flat indexed table, and creates
+  searchIndex view on top of it, so that queries do not repeat the four-way join. The table is
+  rebuilt when the docset index changes.
+*/
 void Docset::createView()
 {
-    static const QString viewCreateQuery
-            = QStringLiteral("CREATE VIEW IF NOT EXISTS searchIndex AS"
-                             "  SELECT"
+    static const QString joinQuery
+            = QStringLiteral("SELECT"
                              "    ztokenname AS name,"
                              "    ztypename AS type,"
                              "    zpath AS path,"
@@ -487,29 +580,159 @@ void Docset::createView()
                              "  INNER JOIN ztokentype"
                              "    ON ztoken.ztokentype = ztokentype.z_pk");
 
-    m_db->execute(viewCreateQuery);
+    // Identifies the docset index contents.
+    QString fingerprint;
+    m_db->prepare(QStringLiteral("SELECT COUNT(*) || ':' || IFNULL(MAX(z_pk), 0) FROM ztoken"));
+    while (m_db->next())
+        fingerprint = m_db->value(0).toString();
+
+    QString tableFingerprint;
+    m_db->execute(QStringLiteral("CREATE TABLE IF NOT EXISTS %1 (key TEXT PRIMARY KEY, value TEXT)")
+                  .arg(MetaTableName));
+    m_db->prepare(QStringLiteral("SELECT value FROM %1 WHERE key = '%2'")
+                  .arg(MetaTableName, SearchTableName));
+    while (m_db->next())
+        tableFingerprint = m_db->value(0).toString();
+
+    if (!fingerprint.isEmpty() && fingerprint == tableFingerprint)
+        return;
+
+    const QStringList queries = {
+        QStringLiteral("DROP VIEW IF EXISTS searchIndex"),
+        QStringLiteral("DROP TABLE IF EXISTS %1").arg(SearchTableName),
+        // Built from searchIndex, see createTocTable().
+        QStringLiteral("DROP TABLE IF EXISTS %1").arg(TocTableName),
+        QStringLiteral("CREATE TABLE %1 AS %2 ORDER BY ztoken.z_pk").arg(SearchTableName, joinQuery),
+        QStringLiteral("CREATE INDEX %1_name ON %1 (name COLLATE NOCASE)").arg(SearchTableName),
+        QStringLiteral("CREATE INDEX %1_type ON %1 (type)").arg(SearchTableName),
+        QStringLiteral("CREATE VIEW searchIndex AS SELECT name, type, path, fragment FROM %1")
+                .arg(SearchTableName),
+        QStringLiteral("INSERT OR REPLACE INTO %1 VALUES ('%2', '%3')")
+                .arg(MetaTableName, SearchTableName, fingerprint)
+    };
+
+    m_db->execute(QStringLiteral("BEGIN"));
+    for (const QString &query : queries) {
+        if (m_db->execute(query))
+            continue;
+
+        qWarning("SQL Error: %s", qPrintable(m_db->lastError()));
+        m_db->execute(QStringLiteral("ROLLBACK"));
+
+        // Fall back to querying Core Data tables directly.
+        m_db->execute(QStringLiteral("CREATE VIEW IF NOT EXISTS searchIndex AS %1").arg(joinQuery));
+        return;
+    }
+
+    m_db->execute(QStringLiteral("COMMIT"));
+}
+
+/*!
+  \internal
+  Creates a table with symbols split by page path and anchor, and indexed by page, so that
+  relatedLinks() is a single index lookup. Rows are inserted in the index order, which docset
+  generators usually follow when parsing pages, so ordering by rowid gives document order.
+
+  The table is built once, when a docset is loaded for the first time.
+*/
+void Docset::createTocTable()
+{
+    // Used by loadSymbols().
+    static const QString typeIndexCreateQuery
+            = QStringLiteral("CREATE INDEX IF NOT EXISTS %1_type ON %1 (type)");
+
+    // Not using tables(), the shared statement may still be in use.
+    m_db->prepare(QStringLiteral("SELECT name FROM sqlite_master"
+                                 "  WHERE type = 'table' AND name = '%1'").arg(TocTableName));
+    while (m_db->next())
+        m_hasTocTable = true;
+
+    if (m_hasTocTable) {
+        m_db->execute(typeIndexCreateQuery.arg(TocTableName));
+        return;
+    }
+
+    static const QString tableCreateQuery
+            = QStringLiteral("CREATE TABLE %1 ("
+                             "  name TEXT,"
+                             "  type TEXT,"
+                             "  path TEXT COLLATE NOCASE,"
+                             "  fragment TEXT)");
+    static const QString indexCreateQuery = QStringLiteral("CREATE INDEX %1_path ON %1 (path)");
+
+    QString tableFillQuery;
+    if (m_type == Type::Dash) {
+        sqlite3_create_function(m_db->handle(), "zealPagePath", 1, SQLITE_UTF8, nullptr,
+                                sqlitePagePathFunction, nullptr, nullptr);
+        sqlite3_create_function(m_db->handle(), "zealPageFragment", 1, SQLITE_UTF8, nullptr,
+                                sqlitePageFragmentFunction, nullptr, nullptr);
+
+        tableFillQuery = QStringLiteral("INSERT INTO %1"
+                                        "  SELECT name, type, zealPagePath(path),"
+                                        "    zealPageFragment(path)"
+                                        "  FROM searchIndex"
+                                        "  ORDER BY rowid");
+    } else {
+        tableFillQuery = QStringLiteral("INSERT INTO %1"
+                                        "  SELECT name, type, path, IFNULL(fragment, '')"
+                                        "  FROM searchIndex");
+    }
+
+    m_db->execute(QStringLiteral("BEGIN"));
+    if (!m_db->execute(tableCreateQuery.arg(TocTableName))
+            || !m_db->execute(tableFillQuery.arg(TocTableName))
+            || !m_db->execute(indexCreateQuery.arg(TocTableName))
+            || !m_db->execute(typeIndexCreateQuery.arg(TocTableName))) {
+        qWarning("SQL Error: %s", qPrintable(m_db->lastError()));
+        m_db->execute(QStringLiteral("ROLLBACK"));
+        return;
+    }
+
+    m_hasTocTable = m_db->execute(QStringLiteral("COMMIT"));
+}
+
+/*!
+  \internal
+  Returns name of the table to query symbols from. For Dash docsets it is the TOC table, which
+  has paths already split and cleaned up, so that createPageUrl() has less work to do.
+*/
+QString Docset::symbolTableName() const
+{
+    if (m_type == Type::Dash && m_hasTocTable)
+        return QString(TocTableName);
+
+    return QStringLiteral("searchIndex");
 }
 
 QUrl Docset::createPageUrl(const QString &path, const QString &fragment) const
 {
-    QString realPath;
-    QString realFragment;
+    QString realPath = path;
+    QString realFragment = fragment;
 
     if (fragment.isEmpty()) {
-        const QStringList urlParts = path.split(QLatin1Char('#'));
-        realPath = urlParts[0];
-        if (urlParts.size() > 1)
-            realFragment = urlParts[1];
-    } else {
-        realPath = path;
-        realFragment = fragment;
+        const int fragmentIndex = path.indexOf(QLatin1Char('#'));
+        if (fragmentIndex != -1) {
+            realPath = path.left(fragmentIndex);
+            realFragment = path.mid(fragmentIndex + 1);
+        }
     }
 
-    static const QRegularExpression dashEntryRegExp(QLatin1String("<dash_entry_.*>"));
-    realPath.remove(dashEntryRegExp);
-    realFragment.remove(dashEntryRegExp);
+    // Paths from the TOC table are already clean.
+    static const QRegularExpression dashEntryRegExp(QLatin1String("<dash_entry_[^>]*>"));
+    if (realPath.contains(QLatin1Char('<')))
+        realPath.remove(dashEntryRegExp);
+    if (realFragment.contains(QLatin1Char('<')))
+        realFragment.remove(dashEntryRegExp);
+
+    QUrl url;
+    if (m_documentPack) {
+        // Packed pages are looked up by their path under the document root.
+        url = QUrl::fromLocalFile(m_documentPath + QLatin1Char('/') + realPath);
+        url.setScheme(Util::PackFile::urlScheme());
+    } else {
+        url = QUrl::fromLocalFile(QDir(m_documentPath).filePath(realPath));
+    }
 
-    QUrl url = QUrl::fromLocalFile(QDir(documentPath()).filePath(realPath));
     if (!realFragment.isEmpty()) {
         if (realFragment.startsWith(QLatin1String("//apple_ref"))
                 || realFragment.startsWith(QLatin1String("//dash_ref"))) {
@@ -522,6 +745,19 @@ QUrl Docset::createPageUrl(const QString &path, const QString &fragment) const
     return url;
 }
 
+// Returns path of the page at \a url relative to the documents directory, without the anchor.
+QString Docset::pagePath(const QUrl &url) const
+{
+    const QString dir = documentPath();
+    const QString urlPath = url.path();
+    const int dirPosition = urlPath.indexOf(dir);
+    const QString path = urlPath.mid(dirPosition + dir.size() + 1);
+
+    QUrl cleanUrl(path);
+    cleanUrl.setFragment(QString());
+    return cleanUrl.toString();
+}
+
 QString Docset::parseSymbolType(const QString &str)
 {
     // Dash symbol aliases
@@ -716,6 +952,8 @@ static void matchFuzzy(const char *needle, int needleLength,
                                haystackLength - j,
                                &recursiveStart, &recursiveLength);
                     if (recursiveStart != -1) {
+                        // The recursive match is relative to the rest of haystack.
+                        recursiveStart += j;
                         int recursiveScore = scoreFuzzy(haystack,
                                                         recursiveStart,
                                                         recursiveLength);
@@ -821,7 +1059,14 @@ static int scoreExact(int matchIndex, int matchLen, const char *value, int value
     return qMax(1, score);
 }
 
-static inline int scoreFunction(const char *needleOrig, const char *haystackOrig)
+/**
+ * \brief Returns score of \a haystackOrig matching \a needleOrig.
+ * \param matchStart If not null, set to the byte position of the scored match.
+ * \param matchLength If not null, set to the byte length of the scored match.
+ * \return Score value, 0 if there is no match.
+ */
+static int scoreFunction(const char *needleOrig, const char *haystackOrig,
+                         int *matchStart, int *matchLength)
 {
     const int needleLength = static_cast<int>(qstrlen(needleOrig));
     const int haystackLength = static_cast<int>(qstrlen(haystackOrig));
@@ -869,14 +1114,22 @@ static inline int scoreFunction(const char *needleOrig, const char *haystackOrig
                    &matchIndex, &matchLength);
     }
 
+    // Matched range reported to the caller, matchFuzzy() positions are one past the first char.
+    int spanStart = -1;
+    int spanLength = 0;
+
     if (matchIndex == -1 && exactIndex == -1) { // no match
         // simply return 0
         return 0;
     } else if (exactIndex != -1) {
         // +100 to make sure exact matches are always on top.
         score = scoreExact(exactIndex, needleLength, haystack.data(), haystackLength) + 100;
+        spanStart = exactIndex;
+        spanLength = needleLength;
     } else {
         score = scoreFuzzy(haystack.data(), matchIndex, matchLength);
+        spanStart = matchIndex - 1;
+        spanLength = matchLength;
 
         int indexOfLastDot;
         for (indexOfLastDot = haystackLength - 1; indexOfLastDot >= 0; --indexOfLastDot) {
@@ -891,15 +1144,96 @@ static inline int scoreFunction(const char *needleOrig, const char *haystackOrig
                        &matchIndex, &matchLength);
 
             if (matchIndex != -1) {
-                score = qMax(score, scoreFuzzy(haystack.data() + indexOfLastDot + 1,
-                                               matchIndex, matchLength));
+                const int lastComponentScore = scoreFuzzy(haystack.data() + indexOfLastDot + 1,
+                                                          matchIndex, matchLength);
+                if (lastComponentScore > score) {
+                    score = lastComponentScore;
+                    spanStart = indexOfLastDot + matchIndex;
+                    spanLength = matchLength;
+                }
             }
         }
     }
 
+    if (matchStart != nullptr)
+        *matchStart = spanStart;
+    if (matchLength != nullptr)
+        *matchLength = spanLength;
+
     return score;
 }
 
+/**
+ * \brief Returns parts of \a name matched by \a query.
+ * \param query Search query.
+ * \param name Symbol name.
+ * \param fuzzy Whether fuzzy matching was used to find the symbol.
+ * \return List of (start, length) pairs.
+ *
+ * Reports the exact occurrence or the range picked by fuzzy matching that scoreFunction() has
+ * ranked the symbol by. Computed once per result on the search thread.
+ */
+static QVector<QPair<int, int>> matchSpans(const QString &query, const QString &name, bool fuzzy)
+{
+    if (query.isEmpty())
+        return {};
+
+    const QByteArray needle = query.toUtf8();
+    const QByteArray haystack = name.toUtf8();
+
+    int start;
+    int length;
+    if (scoreFunction(needle.constData(), haystack.constData(), &start, &length) == 0)
+        return {};
+
+    // Without fuzzy search only substring matches are returned.
+    if (!fuzzy && length != needle.size())
+        return {};
+
+    // Convert UTF-8 offsets to UTF-16 ones.
+    const int spanStart = QString::fromUtf8(haystack.constData(), start).size();
+    const int spanLength = QString::fromUtf8(haystack.constData() + start, length).size();
+    return {{spanStart, spanLength}};
+}
+
+// Returns the page path or anchor of a Dash path, with dash_entry tags removed like in createPageUrl().
+static QString dashPathPart(sqlite3_value *value, bool fragment)
+{
+    QString path = QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_value_text(value)));
+
+    // Each tag ends with its first '>', anchors such as "operator->" can contain more.
+    int dashEntryIndex;
+    while ((dashEntryIndex = path.indexOf(QLatin1String("<dash_entry_"))) != -1) {
+        const int dashEntryEnd = path.indexOf(QLatin1Char('>'), dashEntryIndex);
+        if (dashEntryEnd == -1)
+            break;
+
+        path.remove(dashEntryIndex, dashEntryEnd - dashEntryIndex + 1);
+    }
+
+    const int fragmentIndex = path.indexOf(QLatin1Char('#'));
+    if (fragmentIndex == -1)
+        return fragment ? QString() : path;
+
+    return fragment ? path.mid(fragmentIndex + 1) : path.left(fragmentIndex);
+}
+
+static void sqlitePagePathFunction(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+    Q_UNUSED(argc);
+
+    const QByteArray result = dashPathPart(argv[0], false).toUtf8();
+    sqlite3_result_text(context, result.constData(), result.size(), SQLITE_TRANSIENT);
+}
+
+static void sqlitePageFragmentFunction(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+    Q_UNUSED(argc);
+
+    const QByteArray result = dashPathPart(argv[0], true).toUtf8();
+    sqlite3_result_text(context, result.constData(), result.size(), SQLITE_TRANSIENT);
+}
+
 static void sqliteScoreFunction(sqlite3_context *context, int argc, sqlite3_value **argv)
 {
     Q_UNUSED(argc);
@@ -24,14 +24,19 @@
 #ifndef DOCSET_H
 #define DOCSET_H
 
+#include <QCache>
 #include <QIcon>
 #include <QMap>
 #include <QMetaObject>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QUrl>
 
 namespace Zeal {
 
 namespace Util {
+class PackFile;
+class Plist;
 class SQLiteDatabase;
 }
 
@@ -68,6 +73,7 @@ public:
 
     QList<SearchResult> search(const QString &query, const CancellationToken &token) const;
     QList<SearchResult> relatedLinks(const QUrl &url) const;
+    bool hasCachedRelatedLinks(const QUrl &url) const;
 
     // FIXME: This a temporary solution to create URL on demand.
     QUrl searchResultUrl(const SearchResult &result) const;
@@ -78,6 +84,8 @@ public:
     bool isFuzzySearchEnabled() const;
     void setFuzzySearchEnabled(bool enabled);
 
+    static QStringList plistKeywords(const QString &path);
+
 private:
     enum class Type {
         Invalid,
@@ -91,8 +99,12 @@ private:
     void loadSymbols(const QString &symbolType, const QString &symbolString) const;
     void createIndex();
     void createView();
+    void createTocTable();
+    QString symbolTableName() const;
     QUrl createPageUrl(const QString &path, const QString &fragment = QString()) const;
+    QString pagePath(const QUrl &url) const;
 
+    static QStringList plistKeywords(const Util::Plist &plist);
     static QString parseSymbolType(const QString &str);
 
     QString m_name;
@@ -102,6 +114,8 @@ private:
     QString m_revision;
     Docset::Type m_type = Type::Invalid;
     QString m_path;
+    QString m_documentPath;
+    QSharedPointer<Util::PackFile> m_documentPack;
     QIcon m_icon;
 
     QUrl m_indexFileUrl;
@@ -110,7 +124,14 @@ private:
     QMap<QString, int> m_symbolCounts;
     mutable QMap<QString, QMap<QString, QUrl>> m_symbols;
     Util::SQLiteDatabase *m_db = nullptr;
+    // Queries are run from search, TOC and GUI threads.
+    mutable QMutex m_dbMutex;
     bool m_fuzzySearchEnabled = false;
+    bool m_hasTocTable = false;
+
+    // Related links of recently visited pages, keyed by page path.
+    mutable QCache<QString, QList<SearchResult>> m_relatedLinksCache;
+    mutable QMutex m_relatedLinksCacheMutex;
 };
 
 } // namespace Registry
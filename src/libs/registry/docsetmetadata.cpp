@@ -65,6 +65,8 @@ DocsetMetadata::DocsetMetadata(const QJsonObject &jsonObject)
     for (const QJsonValueRef vv : jsonObject[QStringLiteral("urls")].toArray())
         m_urls.append(QUrl(vv.toString()));
 
+    m_manifestUrl = QUrl(jsonObject[QStringLiteral("manifest_url")].toString());
+
     m_extra = jsonObject[QStringLiteral("extra")].toObject();
 }
 
@@ -161,14 +163,20 @@ QUrl DocsetMetadata::feedUrl() const
     return m_feedUrl;
 }
 
-QUrl DocsetMetadata::url() const
+QList<QUrl> DocsetMetadata::urls() const
 {
-    return m_urls.at(qrand() % m_urls.size());
+    return m_urls;
 }
 
-QList<QUrl> DocsetMetadata::urls() const
+/*!
+  Returns URL of the chunk manifest of the latest revision, which allows updating the docset
+  without downloading the whole archive. Returns an empty URL if the source does not provide one.
+
+  \sa Zeal::Core::ChunkManifest
+*/
+QUrl DocsetMetadata::manifestUrl() const
 {
-    return m_urls;
+    return m_manifestUrl;
 }
 
 DocsetMetadata DocsetMetadata::fromDashFeed(const QUrl &feedUrl, const QByteArray &data)
@@ -199,6 +207,11 @@ DocsetMetadata DocsetMetadata::fromDashFeed(const QUrl &feedUrl, const QByteArra
             if (xml.readNext() != QXmlStreamReader::Characters)
                 continue;
             metadata.m_urls.append(QUrl(xml.text().toString()));
+        } else if (xml.name() == QLatin1String("manifest")) {
+            if (xml.readNext() != QXmlStreamReader::Characters)
+                continue;
+            // Relative to the feed, so that a feed and its chunks can be served together.
+            metadata.m_manifestUrl = feedUrl.resolved(QUrl(xml.text().toString()));
         }
     }
 
@@ -49,8 +49,8 @@ public:
     QIcon icon() const;
 
     QUrl feedUrl() const;
-    QUrl url() const;
     QList<QUrl> urls() const;
+    QUrl manifestUrl() const;
 
     static DocsetMetadata fromDashFeed(const QUrl &feedUrl, const QByteArray &data);
 
@@ -69,6 +69,7 @@ private:
 
     QUrl m_feedUrl;
     QList<QUrl> m_urls;
+    QUrl m_manifestUrl;
 };
 
 } // namespace Registry
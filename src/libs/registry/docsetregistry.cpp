@@ -28,14 +28,25 @@
 #include "searchresult.h"
 
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
 #include <QThread>
+#include <QTimer>
 
 #include <QtConcurrent/QtConcurrent>
 
+#include <algorithm>
 #include <functional>
 
 using namespace Zeal::Registry;
 
+namespace {
+// Delay before a storage change is handled, so that bursts of events are handled once.
+const int ScanDelay = 1000;
+// Leave some of the global thread pool to searches while docsets are loading.
+const int MaxConcurrentLoads = qMax(1, QThread::idealThreadCount() / 2);
+}
+
 void MergeQueryResults(QList<SearchResult> &finalResult, const QList<SearchResult> &partial)
 {
     finalResult << partial;
@@ -43,21 +54,39 @@ void MergeQueryResults(QList<SearchResult> &finalResult, const QList<SearchResul
 
 DocsetRegistry::DocsetRegistry(QObject *parent) :
     QObject(parent),
-    m_thread(new QThread(this))
+    m_fileSystemWatcher(new QFileSystemWatcher(this)),
+    m_scanTimer(new QTimer(this))
 {
     // Register for use in signal connections.
     qRegisterMetaType<QList<SearchResult>>("QList<SearchResult>");
 
-    // FIXME: Only search should be performed in a separate thread
-    moveToThread(m_thread);
-    m_thread->start();
+    // Queries are run one after another, each one searches docsets in the global thread pool.
+    m_searchThreadPool.setMaxThreadCount(1);
+
+    m_scanTimer->setInterval(ScanDelay);
+    m_scanTimer->setSingleShot(true);
+    connect(m_scanTimer, &QTimer::timeout, this, &DocsetRegistry::scanStoragePath);
+    connect(m_fileSystemWatcher, &QFileSystemWatcher::directoryChanged,
+            m_scanTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
 }
 
 DocsetRegistry::~DocsetRegistry()
 {
-    m_thread->exit();
-    m_thread->wait();
-    qDeleteAll(m_docsets);
+    {
+        QMutexLocker locker(&m_queryMutex);
+        m_cancellationToken.cancel();
+        m_hasPendingQuery = false;
+        m_pendingDocsets.clear();
+    }
+
+    m_searchThreadPool.waitForDone();
+
+    // Loaded docsets have not been handed over yet.
+    for (QFutureWatcher<Docset *> *watcher : m_loadWatchers) {
+        watcher->waitForFinished();
+        delete watcher->result();
+        delete watcher;
+    }
 }
 
 QString DocsetRegistry::storagePath() const
@@ -73,8 +102,16 @@ void DocsetRegistry::setStoragePath(const QString &path)
 
     m_storagePath = path;
 
+    for (const QString &queuedPath : m_loadQueue)
+        m_loadingDocsets.remove(queuedPath);
+    m_indexTimestamps.clear();
+
+    m_loadQueue.clear();
+    m_queuedKeywords.clear();
+
     unloadAllDocsets();
-    addDocsetsFromFolder(path);
+
+    scanStoragePath();
 }
 
 bool DocsetRegistry::isFuzzySearchEnabled() const
@@ -90,7 +127,7 @@ void DocsetRegistry::setFuzzySearchEnabled(bool enabled)
 
     m_fuzzySearchEnabled = enabled;
 
-    for (Docset *docset : m_docsets) {
+    for (const QSharedPointer<Docset> &docset : m_docsets) {
         docset->setFuzzySearchEnabled(enabled);
     }
 }
@@ -110,41 +147,139 @@ QStringList DocsetRegistry::names() const
     return m_docsets.keys();
 }
 
+/*!
+  Queues loading of the docset at \a path. Only a few docsets are loaded at once, see
+  loadQueuedDocsets().
+*/
 void DocsetRegistry::loadDocset(const QString &path)
 {
-    QFutureWatcher<Docset *> *watcher = new QFutureWatcher<Docset *>();
-    connect(watcher, &QFutureWatcher<Docset *>::finished, this, [this, watcher] {
-        QScopedPointer<QFutureWatcher<Docset *>, QScopedPointerDeleteLater> guard(watcher);
+    const QString cleanPath = QDir::cleanPath(path);
+    if (m_loadQueue.contains(cleanPath))
+        return;
 
-        Docset *docset = watcher->result();
-        // TODO: Emit error
-        if (!docset->isValid()) {
-            qWarning("Could not load docset from '%s'. Reinstall the docset.",
-                     qPrintable(docset->path()));
-            delete docset;
-            return;
-        }
+    m_loadingDocsets.insert(cleanPath);
+    m_loadQueue.append(cleanPath);
+    loadQueuedDocsets();
+}
 
-        docset->setFuzzySearchEnabled(m_fuzzySearchEnabled);
+/*!
+  Returns \c true while there are docsets being loaded or waiting to be loaded.
+*/
+bool DocsetRegistry::isLoading() const
+{
+    return m_runningLoadCount > 0 || !m_loadQueue.isEmpty();
+}
 
-        const QString name = docset->name();
-        if (m_docsets.contains(name)) {
-            unloadDocset(name);
-        }
+/*!
+  \internal
+  Starts loading queued docsets, as long as there are free loading slots.
+*/
+void DocsetRegistry::loadQueuedDocsets()
+{
+    while (m_runningLoadCount < MaxConcurrentLoads && !m_loadQueue.isEmpty()) {
+        const QString path = m_loadQueue.takeAt(nextQueuedDocset());
+        m_queuedKeywords.remove(path);
+        ++m_runningLoadCount;
+
+        QFutureWatcher<Docset *> *watcher = new QFutureWatcher<Docset *>();
+        connect(watcher, &QFutureWatcher<Docset *>::finished, this, [this, watcher, path] {
+            QScopedPointer<QFutureWatcher<Docset *>, QScopedPointerDeleteLater> guard(watcher);
+            m_loadWatchers.removeOne(watcher);
+
+            // The index is modified while loading, so remember its state afterwards.
+            m_loadingDocsets.remove(path);
+            m_indexTimestamps.insert(path, indexFileInfo(path).lastModified());
+
+            --m_runningLoadCount;
+            loadQueuedDocsets();
+
+            Docset *docset = watcher->result();
+            // TODO: Emit error
+            if (!docset->isValid()) {
+                qWarning("Could not load docset from '%s'. Reinstall the docset.",
+                         qPrintable(docset->path()));
+                delete docset;
+                return;
+            }
+
+            docset->setFuzzySearchEnabled(m_fuzzySearchEnabled);
+
+            const QString name = docset->name();
+            if (m_docsets.contains(name)) {
+                replaceDocset(docset);
+            } else {
+                m_docsets[name] = QSharedPointer<Docset>(docset);
+                emit docsetLoaded(name);
+            }
+
+            searchLoadedDocset(name);
+        });
+
+        // Only the loader's own data is touched off the GUI thread.
+        watcher->setFuture(QtConcurrent::run([path] {
+            return new Docset(path);
+        }));
+        m_loadWatchers.append(watcher);
+    }
+}
 
-        m_docsets[name] = docset;
-        emit docsetLoaded(name);
-    });
+/*!
+  \internal
+  Returns position of the docset in the load queue that should be loaded next. Docsets matching
+  keywords of the active query go first, so that its results are complete as soon as possible.
+*/
+int DocsetRegistry::nextQueuedDocset()
+{
+    const SearchQuery searchQuery = SearchQuery::fromString(m_activeQuery);
+    if (!searchQuery.hasKeywords())
+        return 0;
 
-    watcher->setFuture(QtConcurrent::run([path] {
-        return new Docset(path);
-    }));
+    for (int i = 0; i < m_loadQueue.size(); ++i) {
+        const QString &path = m_loadQueue.at(i);
+        if (!m_queuedKeywords.contains(path))
+            m_queuedKeywords.insert(path, Docset::plistKeywords(path));
+
+        if (searchQuery.hasKeywords(m_queuedKeywords.value(path)))
+            return i;
+    }
+
+    return 0;
 }
 
+/*!
+  \internal
+  Switches a loaded docset to \a docset, its new version, without unloading it. Results of the
+  previous version are kept until the active query is run against the new one.
+*/
+void DocsetRegistry::replaceDocset(Docset *docset)
+{
+    const QString name = docset->name();
+
+    // Keep the previous version alive for handlers of docsetReplaced().
+    const QSharedPointer<Docset> previousDocset = m_docsets.value(name);
+    m_docsets[name] = QSharedPointer<Docset>(docset);
+
+    for (SearchResult &result : m_results) {
+        if (result.docset == previousDocset.data())
+            result.docset = docset;
+    }
+
+    emit docsetReplaced(name, previousDocset.data());
+}
+
+/*!
+  Unloads docset \a name. The docset is deleted once searches still using it are done.
+*/
 void DocsetRegistry::unloadDocset(const QString &name)
 {
     emit docsetAboutToBeUnloaded(name);
-    delete m_docsets.take(name);
+
+    const QSharedPointer<Docset> docset = m_docsets.take(name);
+    m_results.erase(std::remove_if(m_results.begin(), m_results.end(),
+                                   [&docset](const SearchResult &result) {
+        return result.docset == docset.data();
+    }), m_results.end());
+
     emit docsetUnloaded(name);
 }
 
@@ -157,77 +292,319 @@ void DocsetRegistry::unloadAllDocsets()
 
 Docset *DocsetRegistry::docset(const QString &name) const
 {
-    return m_docsets[name];
+    return m_docsets.value(name).data();
 }
 
 Docset *DocsetRegistry::docset(int index) const
 {
     if (index < 0 || index >= m_docsets.size())
         return nullptr;
-    return (m_docsets.cbegin() + index).value();
+    return (m_docsets.cbegin() + index).value().data();
 }
 
 QList<Docset *> DocsetRegistry::docsets() const
 {
-    return m_docsets.values();
+    QList<Docset *> list;
+    for (const QSharedPointer<Docset> &docset : m_docsets)
+        list.append(docset.data());
+    return list;
 }
 
+/*!
+  Returns docset \a name, which stays valid for the returned pointer's lifetime even if the
+  docset is unloaded. Use for work done outside of the GUI thread.
+*/
+QSharedPointer<Docset> DocsetRegistry::sharedDocset(const QString &name) const
+{
+    return m_docsets.value(name);
+}
+
+/*!
+  Starts searching for \a query.
+
+  The search starts immediately when no other search is running. Otherwise the running search
+  is cancelled and only the most recent query is kept, so that queries issued while the search
+  thread is busy do not pile up.
+
+  Docsets that are still loading are not waited for. The query is run against each of them once
+  loaded, and searchCompleted() is emitted again with the new results merged in.
+*/
 void DocsetRegistry::search(const QString &query)
 {
+    m_activeQuery = query;
+    m_results.clear();
+
+    QMutexLocker locker(&m_queryMutex);
+
     m_cancellationToken.cancel();
 
     if (query.isEmpty()) {
-        emit searchCompleted({});
+        m_hasPendingQuery = false;
+        m_pendingDocsets.clear();
+        locker.unlock();
+
+        emit searchCompleted(query, {});
         return;
     }
 
-    QMetaObject::invokeMethod(this, "_runQuery", Qt::QueuedConnection, Q_ARG(QString, query));
+    m_pendingQuery = query;
+    // Loading and unloading docsets detaches m_docsets, the copy stays as it is now.
+    m_pendingDocsets = m_docsets;
+    m_isPendingQueryIncremental = false;
+    m_hasPendingQuery = true;
+
+    startSearchThread();
 }
 
-void DocsetRegistry::_runQuery(const QString &query)
+/*!
+  \internal
+  Runs the active query against docset \a name, which has just been loaded.
+*/
+void DocsetRegistry::searchLoadedDocset(const QString &name)
 {
-    m_cancellationToken.reset();
+    if (m_activeQuery.isEmpty())
+        return;
 
-    QList<Docset *> enabledDocsets;
+    QMutexLocker locker(&m_queryMutex);
+
+    if (m_hasPendingQuery && !m_isPendingQueryIncremental) {
+        // The full query has not started yet, let it see the new docset.
+        m_pendingDocsets = m_docsets;
+        return;
+    }
+
+    if (!m_hasPendingQuery) {
+        m_pendingQuery = m_activeQuery;
+        m_pendingDocsets.clear();
+        m_isPendingQueryIncremental = true;
+        m_hasPendingQuery = true;
+    }
+
+    m_pendingDocsets.insert(name, m_docsets.value(name));
+
+    startSearchThread();
+}
+
+// Must be called with m_queryMutex locked.
+void DocsetRegistry::startSearchThread()
+{
+    if (m_isSearchRunning)
+        return;
+
+    m_isSearchRunning = true;
+    QtConcurrent::run(&m_searchThreadPool, [this] { runQueries(); });
+}
+
+/*!
+  Returns average time in milliseconds recent searches took to complete.
+*/
+int DocsetRegistry::searchLatency() const
+{
+    QMutexLocker locker(&m_queryMutex);
+    return m_searchLatency;
+}
+
+// Runs in the search thread until there are no more queries to run.
+void DocsetRegistry::runQueries()
+{
+    for (;;) {
+        QString query;
+        DocsetMap docsets;
+        bool isIncremental;
+
+        {
+            QMutexLocker locker(&m_queryMutex);
+            if (!m_hasPendingQuery) {
+                m_isSearchRunning = false;
+                return;
+            }
+
+            query = m_pendingQuery;
+            docsets = m_pendingDocsets;
+            isIncremental = m_isPendingQueryIncremental;
+            m_pendingDocsets.clear();
+            m_hasPendingQuery = false;
+            m_cancellationToken.reset();
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        const QList<SearchResult> results = runQuery(query, docsets);
+        if (m_cancellationToken.isCanceled())
+            continue;
+
+        // Searching a few newly loaded docsets says little about how long a full search takes.
+        if (!isIncremental) {
+            QMutexLocker locker(&m_queryMutex);
+            const int latency = static_cast<int>(timer.elapsed());
+            // Smooth out single slow or fast queries.
+            m_searchLatency = m_searchLatency == 0 ? latency : (m_searchLatency * 3 + latency) / 4;
+        }
+
+        QMetaObject::invokeMethod(this, "_completeQuery", Qt::QueuedConnection,
+                                  Q_ARG(QString, query),
+                                  Q_ARG(QList<SearchResult>, results),
+                                  Q_ARG(QStringList, docsets.keys()),
+                                  Q_ARG(bool, isIncremental));
+    }
+}
+
+QList<SearchResult> DocsetRegistry::runQuery(const QString &query, const DocsetMap &docsets)
+{
+    QList<QSharedPointer<Docset>> enabledDocsets;
 
     const SearchQuery searchQuery = SearchQuery::fromString(query);
     if (searchQuery.hasKeywords()) {
-        for (Docset *docset : m_docsets) {
+        for (const QSharedPointer<Docset> &docset : docsets) {
             if (searchQuery.hasKeywords(docset->keywords()))
                 enabledDocsets << docset;
         }
     } else {
-        enabledDocsets = docsets();
+        enabledDocsets = docsets.values();
     }
 
+    const std::function<QList<SearchResult>(const QSharedPointer<Docset> &)> searchDocset
+            = [this, &searchQuery](const QSharedPointer<Docset> &docset) {
+        return docset->search(searchQuery.query(), m_cancellationToken);
+    };
+
     QFuture<QList<SearchResult>> queryResultsFuture
-            = QtConcurrent::mappedReduced(enabledDocsets,
-                                          std::bind(&Docset::search,
-                                                    std::placeholders::_1,
-                                                    searchQuery.query(),
-                                                    std::ref(m_cancellationToken)),
-                                          &MergeQueryResults);
+            = QtConcurrent::mappedReduced(enabledDocsets, searchDocset, &MergeQueryResults);
     QList<SearchResult> results = queryResultsFuture.result();
 
     if (m_cancellationToken.isCanceled())
-        return;
+        return {};
 
     std::sort(results.begin(), results.end());
+    return results;
+}
 
-    if (m_cancellationToken.isCanceled())
+/*!
+  \internal
+  Delivers search \a results for \a query in the GUI thread, dropping those from docsets
+  unloaded or replaced meanwhile. Results of an \a incremental search are merged into the current
+  ones, replacing previous results from the searched docsets \a docsetNames.
+*/
+void DocsetRegistry::_completeQuery(const QString &query, const QList<SearchResult> &results,
+                                    const QStringList &docsetNames, bool incremental)
+{
+    // Results could be late for a docset loaded right before the query has changed.
+    if (query != m_activeQuery)
         return;
 
-    emit searchCompleted(results);
+    QSet<Docset *> loadedDocsets;
+    for (const QSharedPointer<Docset> &docset : m_docsets)
+        loadedDocsets.insert(docset.data());
+
+    QList<SearchResult> loadedResults;
+    loadedResults.reserve(results.size());
+    for (const SearchResult &result : results) {
+        if (loadedDocsets.contains(result.docset))
+            loadedResults.append(result);
+    }
+
+    if (!incremental) {
+        m_results = loadedResults;
+    } else {
+        // Results of a previous version of a replaced docset are superseded.
+        const QSet<QString> searchedDocsets = docsetNames.toSet();
+        const int previousCount = m_results.size();
+        m_results.erase(std::remove_if(m_results.begin(), m_results.end(),
+                                       [&searchedDocsets](const SearchResult &result) {
+            return searchedDocsets.contains(result.docset->name());
+        }), m_results.end());
+
+        if (loadedResults.isEmpty() && m_results.size() == previousCount)
+            return;
+
+        // Both lists are sorted.
+        QList<SearchResult> mergedResults;
+        mergedResults.reserve(m_results.size() + loadedResults.size());
+        std::merge(m_results.cbegin(), m_results.cend(),
+                   loadedResults.cbegin(), loadedResults.cend(),
+                   std::back_inserter(mergedResults));
+        m_results = mergedResults;
+    }
+
+    emit searchCompleted(m_activeQuery, m_results);
+}
+
+/*!
+  \internal
+  Synchronizes loaded docsets with the storage directory: loads new docsets, unloads removed ones,
+  and reloads docsets whose index has changed since they have been loaded. Watches the storage
+  directory to repeat the scan when its contents change.
+*/
+void DocsetRegistry::scanStoragePath()
+{
+    QStringList docsetPaths;
+    QStringList directories;
+    if (!m_storagePath.isEmpty())
+        findDocsets(QDir::cleanPath(m_storagePath), &docsetPaths, &directories);
+
+    // Unload docsets removed from the storage.
+    for (const QSharedPointer<Docset> &docset : m_docsets.values()) {
+        if (!docsetPaths.contains(QDir::cleanPath(docset->path())))
+            unloadDocset(docset->name());
+    }
+
+    QStringList pathsToLoad;
+
+    for (const QString &path : m_indexTimestamps.keys()) {
+        if (!docsetPaths.contains(path))
+            m_indexTimestamps.remove(path);
+    }
+
+    for (const QString &path : docsetPaths) {
+        directories.append(path);
+
+        // Skip docsets that are still being extracted.
+        const QFileInfo indexFile = indexFileInfo(path);
+        if (!indexFile.exists())
+            continue;
+
+        directories.append(indexFile.path());
+
+        if (m_loadingDocsets.contains(path))
+            continue;
+
+        if (m_indexTimestamps.contains(path)
+                && m_indexTimestamps.value(path) == indexFile.lastModified()) {
+            continue;
+        }
+
+        pathsToLoad.append(path);
+    }
+
+    // Loading replaces a docset with the same name.
+    for (const QString &path : pathsToLoad)
+        loadDocset(path);
+
+    if (!m_fileSystemWatcher->directories().isEmpty())
+        m_fileSystemWatcher->removePaths(m_fileSystemWatcher->directories());
+    if (!directories.isEmpty())
+        m_fileSystemWatcher->addPaths(directories);
 }
 
-// Recursively finds and adds all docsets in a given directory.
-void DocsetRegistry::addDocsetsFromFolder(const QString &path)
+// Recursively finds all docsets in a given directory, and collects directories to watch.
+void DocsetRegistry::findDocsets(const QString &path, QStringList *docsetPaths,
+                                 QStringList *directories)
 {
+    directories->append(path);
+
     const QDir dir(path);
     for (const QFileInfo &subdir : dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllDirs)) {
         if (subdir.suffix() == QLatin1String("docset"))
-            loadDocset(subdir.filePath());
-        else
-            addDocsetsFromFolder(subdir.filePath());
+            docsetPaths->append(subdir.filePath());
+        else if (subdir.suffix() != QLatin1String("deleteme") // See FileManager.
+                 && subdir.suffix() != QLatin1String("staging") // Docsets being installed.
+                 && subdir.suffix() != QLatin1String("store")) // See ContentStore.
+            findDocsets(subdir.filePath(), docsetPaths, directories);
     }
 }
+
+QFileInfo DocsetRegistry::indexFileInfo(const QString &docsetPath)
+{
+    return QFileInfo(QDir(docsetPath).filePath(QStringLiteral("Contents/Resources/docSet.dsidx")));
+}
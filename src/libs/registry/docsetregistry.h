@@ -26,10 +26,19 @@
 
 #include "cancellationtoken.h"
 
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
 
-class QThread;
+class QFileInfo;
+class QFileSystemWatcher;
+class QTimer;
 
 namespace Zeal {
 namespace Registry {
@@ -57,33 +66,79 @@ public:
     void loadDocset(const QString &path);
     void unloadDocset(const QString &name);
     void unloadAllDocsets();
+    bool isLoading() const;
 
     Docset *docset(const QString &name) const;
     Docset *docset(int index) const;
     QList<Docset *> docsets() const;
+    QSharedPointer<Docset> sharedDocset(const QString &name) const;
 
     void search(const QString &query);
     const QList<SearchResult> &queryResults();
+    int searchLatency() const;
 
 signals:
     void docsetLoaded(const QString &name);
+    void docsetReplaced(const QString &name, Docset *previousDocset);
     void docsetAboutToBeUnloaded(const QString &name);
     void docsetUnloaded(const QString &name);
-    void searchCompleted(const QList<SearchResult> &results);
+    void searchCompleted(const QString &query, const QList<SearchResult> &results);
 
 private slots:
-    void _runQuery(const QString &query);
+    void _completeQuery(const QString &query, const QList<SearchResult> &results,
+                        const QStringList &docsetNames, bool incremental);
 
 private:
-    void addDocsetsFromFolder(const QString &path);
+    typedef QMap<QString, QSharedPointer<Docset>> DocsetMap;
+
+    void loadQueuedDocsets();
+    int nextQueuedDocset();
+    void replaceDocset(Docset *docset);
+    void searchLoadedDocset(const QString &name);
+    void startSearchThread();
+    void runQueries();
+    QList<SearchResult> runQuery(const QString &query, const DocsetMap &docsets);
+    void scanStoragePath();
+    static void findDocsets(const QString &path, QStringList *docsetPaths,
+                            QStringList *directories);
+    static QFileInfo indexFileInfo(const QString &docsetPath);
 
     QString m_storagePath;
     bool m_fuzzySearchEnabled = false;
 
-    QThread *m_thread = nullptr;
-    QMap<QString, Docset *> m_docsets;
+    // Modified only in the GUI thread. Searches take a copy, which keeps the docsets
+    // it refers to alive until the search is done.
+    DocsetMap m_docsets;
+
+    // Docsets waiting to be loaded, and Info.plist keywords of those looked up for priority.
+    QStringList m_loadQueue;
+    QHash<QString, QStringList> m_queuedKeywords;
+    int m_runningLoadCount = 0;
+    // Running loads, waited for on destruction.
+    QList<QFutureWatcher<Docset *> *> m_loadWatchers;
+
+    // Most recent query and its results, updated as docsets are loaded.
+    QString m_activeQuery;
+    QList<SearchResult> m_results;
 
     CancellationToken m_cancellationToken;
+
+    // Query dispatching, shared with the search thread.
+    QThreadPool m_searchThreadPool;
+    mutable QMutex m_queryMutex;
+    QString m_pendingQuery;
+    DocsetMap m_pendingDocsets;
+    // Whether the pending query only searches newly loaded docsets.
+    bool m_isPendingQueryIncremental = false;
+    bool m_hasPendingQuery = false;
+    bool m_isSearchRunning = false;
+    int m_searchLatency = 0;
+
+    // Docset discovery, lives in the thread the registry has been created in.
+    QFileSystemWatcher *m_fileSystemWatcher = nullptr;
+    QTimer *m_scanTimer = nullptr;
+    QSet<QString> m_loadingDocsets;
+    QHash<QString, QDateTime> m_indexTimestamps;
 };
 
 } // namespace Registry
@@ -35,6 +35,7 @@ ListModel::ListModel(DocsetRegistry *docsetRegistry, QObject *parent) :
 {
     connect(m_docsetRegistry, &DocsetRegistry::docsetLoaded, this, &ListModel::addDocset);
     connect(m_docsetRegistry, &DocsetRegistry::docsetAboutToBeUnloaded, this, &ListModel::removeDocset);
+    connect(m_docsetRegistry, &DocsetRegistry::docsetReplaced, this, &ListModel::replaceDocset);
 
     for (const QString &name : m_docsetRegistry->names())
         addDocset(name);
@@ -211,6 +212,13 @@ void ListModel::removeDocset(const QString &name)
     endRemoveRows();
 }
 
+// Symbol groups of the new version may differ.
+void ListModel::replaceDocset(const QString &name)
+{
+    removeDocset(name);
+    addDocset(name);
+}
+
 QString ListModel::pluralize(const QString &s)
 {
     if (s.endsWith(QLatin1String("y")))
@@ -49,6 +49,7 @@ public:
 private slots:
     void addDocset(const QString &name);
     void removeDocset(const QString &name);
+    void replaceDocset(const QString &name);
 
 private:
     enum Level {
@@ -28,6 +28,11 @@
 
 using namespace Zeal::Registry;
 
+namespace {
+// Number of rows made available to views at once, further rows are added by fetchMore().
+const int FetchBatchSize = 250;
+}
+
 SearchModel::SearchModel(QObject *parent) :
     QAbstractListModel(parent)
 {
@@ -35,7 +40,8 @@ SearchModel::SearchModel(QObject *parent) :
 
 SearchModel::SearchModel(const SearchModel &other) :
     QAbstractListModel(other.d_ptr->parent),
-    m_dataList(other.m_dataList)
+    m_dataList(other.m_dataList),
+    m_rowCount(other.m_rowCount)
 {
 }
 
@@ -64,6 +70,9 @@ QVariant SearchModel::data(const QModelIndex &index, int role) const
     case ItemDataRole::UrlRole:
         return item->docset->searchResultUrl(*item);
 
+    case ItemDataRole::MatchSpansRole:
+        return QVariant::fromValue(item->matchSpans);
+
     default:
         return QVariant();
     }
@@ -71,7 +80,7 @@ QVariant SearchModel::data(const QModelIndex &index, int role) const
 
 QModelIndex SearchModel::index(int row, int column, const QModelIndex &parent) const
 {
-    if (parent.isValid() || m_dataList.count() <= row || column > 1)
+    if (parent.isValid() || m_rowCount <= row || column > 1)
         return QModelIndex();
 
     // FIXME: const_cast
@@ -82,14 +91,38 @@ QModelIndex SearchModel::index(int row, int column, const QModelIndex &parent) c
 int SearchModel::rowCount(const QModelIndex &parent) const
 {
     if (!parent.isValid())
-        return m_dataList.count();
+        return m_rowCount;
     return 0;
 }
 
+/*!
+  Returns whether some of the held results are not exposed to views yet. Fetching only batches
+  creation of rows in views, the results themselves are already in memory.
+*/
+bool SearchModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && m_rowCount < m_dataList.size();
+}
+
+void SearchModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+
+    const int count = qMin(FetchBatchSize, m_dataList.size() - m_rowCount);
+    if (count <= 0)
+        return;
+
+    beginInsertRows(parent, m_rowCount, m_rowCount + count - 1);
+    m_rowCount += count;
+    endInsertRows();
+}
+
 bool SearchModel::removeRows(int row, int count, const QModelIndex &parent)
 {
-    if (row + count <= m_dataList.size() && !parent.isValid()) {
+    if (row + count <= m_rowCount && !parent.isValid()) {
         beginRemoveRows(parent, row, row + count - 1);
+        m_rowCount -= count;
         while (count) {
             m_dataList.removeAt(row);
             --count;
@@ -107,19 +140,68 @@ void SearchModel::removeSearchResultWithName(const QString &name)
     int rowNum = 0;
     while (iterator.hasNext()) {
         if (iterator.next().docset->name() == name) {
-            beginRemoveRows(QModelIndex(), rowNum, rowNum);
-            iterator.remove();
+            // Rows that have not been fetched yet are unknown to views.
+            if (rowNum < m_rowCount) {
+                beginRemoveRows(QModelIndex(), rowNum, rowNum);
+                iterator.remove();
+                --m_rowCount;
+                endRemoveRows();
+            } else {
+                iterator.remove();
+            }
             rowNum -= 1;
-            endRemoveRows();
         }
         rowNum += 1;
     }
 }
 
+/*!
+  Points results from \a previousDocset to \a docset, its new version, so that they stay valid
+  after the previous version is deleted.
+*/
+void SearchModel::replaceDocset(Docset *previousDocset, Docset *docset)
+{
+    int firstRow = -1;
+    int lastRow = -1;
+
+    for (int i = 0; i < m_dataList.size(); ++i) {
+        if (m_dataList.at(i).docset != previousDocset)
+            continue;
+
+        m_dataList[i].docset = docset;
+
+        if (i < m_rowCount) {
+            if (firstRow == -1)
+                firstRow = i;
+            lastRow = i;
+        }
+    }
+
+    // Icons may have changed.
+    if (firstRow != -1)
+        emit dataChanged(index(firstRow, 0, QModelIndex()), index(lastRow, 0, QModelIndex()));
+}
+
+/*!
+  Drops the reference to the current results without emitting updated(). Used to free results
+  held by models that are not visible.
+*/
+void SearchModel::releaseResults()
+{
+    if (m_dataList.isEmpty())
+        return;
+
+    beginResetModel();
+    m_dataList = QList<SearchResult>();
+    m_rowCount = 0;
+    endResetModel();
+}
+
 void SearchModel::setResults(const QList<SearchResult> &results)
 {
     beginResetModel();
     m_dataList = results;
+    m_rowCount = qMin(FetchBatchSize, m_dataList.size());
     endResetModel();
     emit updated();
 }
@@ -43,8 +43,12 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QModelIndex index(int row, int column, const QModelIndex &parent) const override;
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
     bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
     void removeSearchResultWithName(const QString &name);
+    void replaceDocset(Docset *previousDocset, Docset *docset);
+    void releaseResults();
 
 public slots:
     void setResults(const QList<SearchResult> &results = QList<SearchResult>());
@@ -53,7 +57,12 @@ signals:
     void updated();
 
 private:
+    // All ranked results, only the first m_rowCount of them are exposed to views. Only view
+    // population is batched: the complete list is held here regardless of how many rows have
+    // been fetched. It is implicitly shared with the registry and other models holding the same
+    // results, and is only detached when results are removed.
     QList<SearchResult> m_dataList;
+    int m_rowCount = 0;
 };
 
 } // namespace Registry
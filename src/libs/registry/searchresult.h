@@ -24,8 +24,10 @@
 #ifndef SEARCHRESULT_H
 #define SEARCHRESULT_H
 
+#include <QPair>
 #include <QString>
 #include <QUrl>
+#include <QVector>
 
 namespace Zeal {
 namespace Registry {
@@ -44,6 +46,9 @@ struct SearchResult
 
     int score;
 
+    // Matched parts of the name as (start, length) pairs.
+    QVector<QPair<int, int>> matchSpans;
+
     inline bool operator<(const SearchResult &other) const
     {
         if (score == other.score)
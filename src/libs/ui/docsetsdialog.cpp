@@ -28,6 +28,10 @@
 #include "progressitemdelegate.h"
 
 #include <core/application.h>
+#include <core/archivestream.h>
+#include <core/contentstore.h>
+#include <core/deltaupdate.h>
+#include <core/downloadmanager.h>
 #include <core/filemanager.h>
 #include <core/settings.h>
 #include <registry/docset.h>
@@ -37,6 +41,7 @@
 
 #include <QClipboard>
 #include <QDir>
+#include <QFutureWatcher>
 #include <QInputDialog>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -44,9 +49,13 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QStandardPaths>
-#include <QTemporaryFile>
 #include <QUrl>
 
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <functional>
+
 using namespace Zeal;
 using namespace Zeal::WidgetUi;
 
@@ -55,6 +64,9 @@ const char ApiServerUrl[] = "http://api.zealdocs.org/v1";
 const char RedirectServerUrl[] = "https://go.zealdocs.org";
 // TODO: Each source plugin should have its own cache
 const char DocsetListCacheFileName[] = "com.kapeli.json";
+const char PartialDownloadFileSuffix[] = ".docset.part";
+// Docsets are extracted next to the installed version, and renamed once complete.
+const char StagingDirectorySuffix[] = ".staging";
 
 // TODO: Make the timeout period configurable
 constexpr int CacheTimeout = 24 * 60 * 60 * 1000; // 24 hours in microseconds
@@ -94,7 +106,7 @@ DocsetsDialog::DocsetsDialog(Core::Application *app, QWidget *parent) :
             return;
         }
 
-        downloadDashDocset(index);
+        downloadDashDocset(index, Core::Download::HighPriority);
     });
 
     QItemSelectionModel *selectionModel = ui->installedDocsetList->selectionModel();
@@ -134,7 +146,7 @@ DocsetsDialog::DocsetsDialog(Core::Application *app, QWidget *parent) :
         model->setData(index, 0, ProgressItemDelegate::ValueRole);
         model->setData(index, true, ProgressItemDelegate::ShowProgressRole);
 
-        downloadDashDocset(index);
+        downloadDashDocset(index, Core::Download::HighPriority);
     });
 
     selectionModel = ui->availableDocsetList->selectionModel();
@@ -170,26 +182,29 @@ DocsetsDialog::DocsetsDialog(Core::Application *app, QWidget *parent) :
     connect(ui->addFeedButton, &QPushButton::clicked, this, &DocsetsDialog::addDashFeed);
     connect(ui->refreshButton, &QPushButton::clicked, this, &DocsetsDialog::downloadDocsetList);
 
-    connect(m_application, &Core::Application::extractionCompleted,
-            this, &DocsetsDialog::extractionCompleted);
-    connect(m_application, &Core::Application::extractionError,
-            this, &DocsetsDialog::extractionError);
-    connect(m_application, &Core::Application::extractionProgress,
-            this, &DocsetsDialog::extractionProgress);
-
     connect(ui->cancelButton, &QPushButton::clicked, this, &DocsetsDialog::cancelDownloads);
+    connect(m_application->downloadManager(), &Core::DownloadManager::progressChanged,
+            this, &DocsetsDialog::updateCombinedProgress);
 
     loadDocsetList();
+    updateSavedSpace();
 }
 
 DocsetsDialog::~DocsetsDialog()
 {
+    // Let extraction threads finish.
+    for (const QSharedPointer<Core::ArchiveStream> &stream : m_archiveStreams)
+        stream->abort();
+    for (const QSharedPointer<Core::ArchiveStream> &stream : m_pendingArchiveStreams)
+        stream->abort();
+
     delete ui;
 }
 
 void DocsetsDialog::reject()
 {
-    if (m_replies.isEmpty() && m_tmpFiles.isEmpty()) {
+    if (m_replies.isEmpty() && m_downloads.isEmpty() && m_deltaUpdates.isEmpty()
+            && m_archiveStreams.isEmpty()) {
         QDialog::reject();
         return;
     }
@@ -224,7 +239,7 @@ void DocsetsDialog::updateSelectedDocsets()
         if (!index.data(Registry::ItemDataRole::UpdateAvailableRole).toBool())
             continue;
 
-        downloadDashDocset(index);
+        downloadDashDocset(index, Core::Download::NormalPriority);
     }
 }
 
@@ -236,7 +251,7 @@ void DocsetsDialog::updateAllDocsets()
         if (!index.data(Registry::ItemDataRole::UpdateAvailableRole).toBool())
             continue;
 
-        downloadDashDocset(index);
+        downloadDashDocset(index, Core::Download::LowPriority);
     }
 }
 
@@ -301,7 +316,7 @@ void DocsetsDialog::downloadSelectedDocsets()
         model->setData(index, 0, ProgressItemDelegate::ValueRole);
         model->setData(index, true, ProgressItemDelegate::ShowProgressRole);
 
-        downloadDashDocset(index);
+        downloadDashDocset(index, Core::Download::HighPriority);
     }
 }
 
@@ -407,46 +422,57 @@ void DocsetsDialog::downloadCompleted()
         }
 
         m_userFeeds[metadata.name()] = metadata;
-        QNetworkReply *reply = download(metadata.url());
-        reply->setProperty(DocsetNameProperty, metadata.name());
-        reply->setProperty(DownloadTypeProperty, DownloadDocset);
+        updateDocset(metadata.urls(), metadata.name(), Core::Download::HighPriority);
 
         break;
     }
 
-    case DownloadDocset: {
-        const QString docsetName = reply->property(DocsetNameProperty).toString();
-        const QString docsetDirectoryName = docsetName + QLatin1String(".docset");
+    }
 
-        if (QDir(m_application->settings()->docsetPath).exists(docsetDirectoryName)) {
-            removeDocset(docsetName);
-        }
+    // If all enqueued downloads have finished executing
+    if (m_replies.isEmpty() && m_downloads.isEmpty() && m_deltaUpdates.isEmpty())
+        resetProgress();
+}
 
-        QTemporaryFile *tmpFile = m_tmpFiles[docsetName];
-        if (!tmpFile) {
-            tmpFile = new QTemporaryFile(this);
-            tmpFile->open();
-            m_tmpFiles.insert(docsetName, tmpFile);
-        }
+void DocsetsDialog::docsetDownloadCompleted(Core::Download *download)
+{
+    QScopedPointer<Core::Download, QScopedPointerDeleteLater> guard(download);
+
+    m_downloads.removeOne(download);
+
+    const QString docsetName = download->property(DocsetNameProperty).toString();
+
+    // The download has closed or aborted its archive stream.
+    if (download->error() != QNetworkReply::NoError) {
+        if (download->error() != QNetworkReply::OperationCanceledError) {
+            const int ret = QMessageBox::warning(this, QStringLiteral("Zeal"),
+                                                 download->errorString(),
+                                                 QMessageBox::Retry | QMessageBox::Default,
+                                                 QMessageBox::Cancel | QMessageBox::Escape,
+                                                 QMessageBox::NoButton);
 
-        while (reply->bytesAvailable())
-            tmpFile->write(reply->read(1024 * 1024)); // Use small chunks
-        tmpFile->close();
+            if (ret == QMessageBox::Retry) {
+                downloadDocset(download->urls(), docsetName, download->priority());
+                return;
+            }
 
-        QListWidgetItem *item = findDocsetListItem(docsetName);
-        if (item) {
-            item->setData(ProgressItemDelegate::ValueRole, 0);
-            item->setData(ProgressItemDelegate::FormatRole, tr("Installing: %p%"));
+            QListWidgetItem *listItem = findDocsetListItem(docsetName);
+            if (listItem)
+                listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
         }
 
-        m_application->extract(tmpFile->fileName(), m_application->settings()->docsetPath,
-                               docsetDirectoryName);
-        break;
+        resetProgress();
+        return;
     }
+
+    // Extraction is finishing with the remaining data.
+    QListWidgetItem *item = findDocsetListItem(docsetName);
+    if (item) {
+        item->setData(ProgressItemDelegate::ValueRole, 100);
+        item->setData(ProgressItemDelegate::FormatRole, tr("Installing..."));
     }
 
-    // If all enqueued downloads have finished executing
-    if (m_replies.isEmpty())
+    if (m_replies.isEmpty() && m_downloads.isEmpty() && m_deltaUpdates.isEmpty())
         resetProgress();
 }
 
@@ -461,19 +487,6 @@ void DocsetsDialog::downloadProgress(qint64 received, qint64 total)
     if (!reply || !reply->isOpen())
         return;
 
-    if (reply->property(DownloadTypeProperty).toInt() == DownloadDocset) {
-        const QString docsetName = reply->property(DocsetNameProperty).toString();
-
-        QTemporaryFile *tmpFile = m_tmpFiles[docsetName];
-        if (!tmpFile) {
-            tmpFile = new QTemporaryFile(this);
-            tmpFile->open();
-            m_tmpFiles.insert(docsetName, tmpFile);
-        }
-
-        tmpFile->write(reply->read(received));
-    }
-
     // Try to get the item associated to the request
     QListWidgetItem *item
             = ui->availableDocsetList->item(reply->property(ListItemIndexProperty).toInt());
@@ -493,53 +506,6 @@ void DocsetsDialog::downloadProgress(qint64 received, qint64 total)
     updateCombinedProgress();
 }
 
-void DocsetsDialog::extractionCompleted(const QString &filePath)
-{
-    const QString docsetName = docsetNameForTmpFilePath(filePath);
-
-    const QDir dataDir(m_application->settings()->docsetPath);
-    const QString docsetPath = dataDir.filePath(docsetName + QLatin1String(".docset"));
-
-    // Write metadata about docset
-    Registry::DocsetMetadata metadata = m_availableDocsets.contains(docsetName)
-            ? m_availableDocsets[docsetName]
-              : m_userFeeds[docsetName];
-    metadata.save(docsetPath, metadata.latestVersion());
-
-    m_docsetRegistry->loadDocset(docsetPath);
-
-    QListWidgetItem *listItem = findDocsetListItem(docsetName);
-    if (listItem) {
-        listItem->setHidden(true);
-        listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
-    }
-
-    resetProgress();
-    delete m_tmpFiles.take(docsetName);
-}
-
-void DocsetsDialog::extractionError(const QString &filePath, const QString &errorString)
-{
-    const QString docsetName = docsetNameForTmpFilePath(filePath);
-
-    QMessageBox::warning(this, QStringLiteral("Zeal"),
-                         tr("Cannot extract docset <b>%1</b>: %2").arg(docsetName, errorString));
-
-    QListWidgetItem *listItem = findDocsetListItem(docsetName);
-    if (listItem)
-        listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
-
-    delete m_tmpFiles.take(docsetName);
-}
-
-void DocsetsDialog::extractionProgress(const QString &filePath, qint64 extracted, qint64 total)
-{
-    const QString docsetName = docsetNameForTmpFilePath(filePath);
-    QListWidgetItem *listItem = findDocsetListItem(docsetName);
-    if (listItem)
-        listItem->setData(ProgressItemDelegate::ValueRole, percent(extracted, total));
-}
-
 void DocsetsDialog::loadDocsetList()
 {
     const QFileInfo fi(cacheLocation(DocsetListCacheFileName));
@@ -596,18 +562,125 @@ QNetworkReply *DocsetsDialog::download(const QUrl &url)
     connect(reply, &QNetworkReply::finished, this, &DocsetsDialog::downloadCompleted);
     m_replies.append(reply);
 
-    // Installed docsets
-    ui->addFeedButton->setEnabled(false);
-    ui->updateSelectedDocsetsButton->setEnabled(false);
-    ui->updateAllDocsetsButton->setEnabled(false);
-    ui->removeDocsetsButton->setEnabled(false);
+    disableControls();
+    updateCombinedProgress();
 
-    // Available docsets
-    ui->refreshButton->setEnabled(false);
+    return reply;
+}
 
+/*!
+  \internal
+  Queues download of docset \a name archive from the fastest of mirror \a urls. The archive is
+  extracted while it is being downloaded. Downloaded data is passed to the extraction by the
+  download thread, the dialog only receives progress.
+*/
+Core::Download *DocsetsDialog::downloadDocset(const QList<QUrl> &urls, const QString &name,
+                                              Core::Download::Priority priority)
+{
+    Core::Download *download = m_application->downloadManager()->download(urls, priority);
+    // Interrupted downloads are resumed from the cache, also after restart.
+    download->setFilePath(cacheLocation(name + QLatin1String(PartialDownloadFileSuffix)));
+    download->setProperty(DocsetNameProperty, name);
+    download->setProperty(ListItemIndexProperty,
+                          ui->availableDocsetList->row(findDocsetListItem(name)));
+
+    const QSharedPointer<Core::ArchiveStream> stream
+            = QSharedPointer<Core::ArchiveStream>::create();
+    download->setArchiveStream(stream);
+
+    connect(download, &Core::Download::started, this, [this, download, name, stream] {
+        // Data received in the meantime is buffered by the stream.
+        if (!stream->isAborted())
+            extractArchive(name, stream);
+
+        QListWidgetItem *item
+                = ui->availableDocsetList->item(download->property(ListItemIndexProperty).toInt());
+        if (item)
+            item->setData(ProgressItemDelegate::FormatRole, tr("Downloading: %p%"));
+    });
+    connect(download, &Core::Download::progress, this, [this, download](qint64 received,
+                                                                         qint64 total) {
+        QListWidgetItem *item
+                = ui->availableDocsetList->item(download->property(ListItemIndexProperty).toInt());
+        if (item)
+            item->setData(ProgressItemDelegate::ValueRole, percent(received, total));
+    });
+    connect(download, &Core::Download::finished, this, [this, download] {
+        docsetDownloadCompleted(download);
+    });
+    m_downloads.append(download);
+
+    // Downloads are started by the download thread.
+    QListWidgetItem *item = findDocsetListItem(name);
+    if (item)
+        item->setData(ProgressItemDelegate::FormatRole, tr("Waiting..."));
+
+    disableControls();
     updateCombinedProgress();
 
-    return reply;
+    return download;
+}
+
+/*!
+  \internal
+  Updates installed docset \a name by downloading only the changed chunks, if its source
+  provides a chunk manifest. Otherwise, and if the delta update fails, downloads the archive
+  from \a urls.
+*/
+void DocsetsDialog::updateDocset(const QList<QUrl> &urls, const QString &name,
+                                 Core::Download::Priority priority)
+{
+    const Registry::DocsetMetadata metadata = m_availableDocsets.contains(name)
+            ? m_availableDocsets[name]
+              : m_userFeeds[name];
+
+    if (metadata.manifestUrl().isEmpty() || !m_docsetRegistry->contains(name)) {
+        downloadDocset(urls, name, priority);
+        return;
+    }
+
+    if (m_deltaUpdates.contains(name))
+        return;
+
+    const QString stagingPath = QDir(m_application->settings()->docsetPath)
+            .filePath(name + QLatin1String(".docset") + QLatin1String(StagingDirectorySuffix));
+    removeStagedDocset(name);
+
+    Core::DeltaUpdate *update = new Core::DeltaUpdate(metadata.manifestUrl(),
+                                                      m_docsetRegistry->docset(name)->path(),
+                                                      stagingPath, this);
+    if (m_application->settings()->deduplicateDocsetFiles)
+        update->setStoragePath(m_application->settings()->docsetPath);
+    m_deltaUpdates.insert(name, update);
+
+    connect(update, &Core::DeltaUpdate::progress, this, &DocsetsDialog::updateCombinedProgress);
+    connect(update, &Core::DeltaUpdate::finished, this, [this, update, urls, name, priority] {
+        update->deleteLater();
+        m_deltaUpdates.remove(name);
+
+        if (update->isAborted()) {
+            removeStagedDocset(name);
+            resetProgress();
+            return;
+        }
+
+        if (!update->errorString().isEmpty()) {
+            qWarning("Delta update of docset %s failed: %s", qPrintable(name),
+                     qPrintable(update->errorString()));
+            removeStagedDocset(name);
+            downloadDocset(urls, name, priority);
+            return;
+        }
+
+        // Installed the same way as an extracted archive.
+        extractionCompleted(name);
+        updateCombinedProgress();
+    });
+
+    update->start();
+
+    disableControls();
+    updateCombinedProgress();
 }
 
 void DocsetsDialog::cancelDownloads()
@@ -619,15 +692,41 @@ void DocsetsDialog::cancelDownloads()
         if (listItem)
             listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
 
-        if (reply->property(DownloadTypeProperty).toInt() == DownloadDocset)
-            delete m_tmpFiles.take(reply->property(DocsetNameProperty).toString());
-
         reply->abort();
     }
 
+    // Aborting removes downloads from the list.
+    for (Core::Download *download : QList<Core::Download *>(m_downloads)) {
+        const QString docsetName = download->property(DocsetNameProperty).toString();
+
+        QListWidgetItem *listItem = findDocsetListItem(docsetName);
+        if (listItem)
+            listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
+
+        // Stops the extraction right away, the download is aborted in its thread.
+        download->archiveStream()->abort();
+        download->abort();
+    }
+
+    // Aborting removes delta updates from the list, or does once their jobs return.
+    for (Core::DeltaUpdate *update : m_deltaUpdates.values())
+        update->abort();
+
     resetProgress();
 }
 
+void DocsetsDialog::disableControls()
+{
+    // Installed docsets
+    ui->addFeedButton->setEnabled(false);
+    ui->updateSelectedDocsetsButton->setEnabled(false);
+    ui->updateAllDocsetsButton->setEnabled(false);
+    ui->removeDocsetsButton->setEnabled(false);
+
+    // Available docsets
+    ui->refreshButton->setEnabled(false);
+}
+
 void DocsetsDialog::downloadDocsetList()
 {
     ui->availableDocsetList->clear();
@@ -668,7 +767,8 @@ void DocsetsDialog::processDocsetList(const QJsonArray &list)
     ui->installedDocsetList->reset();
 }
 
-void DocsetsDialog::downloadDashDocset(const QModelIndex &index)
+void DocsetsDialog::downloadDashDocset(const QModelIndex &index,
+                                       Core::Download::Priority priority)
 {
     const QString name = index.data(Registry::ItemDataRole::DocsetNameRole).toString();
 
@@ -676,11 +776,7 @@ void DocsetsDialog::downloadDashDocset(const QModelIndex &index)
         return;
 
     const QString urlString = RedirectServerUrl + QStringLiteral("/d/com.kapeli/%1/latest");
-    QNetworkReply *reply = download(QUrl(urlString.arg(name)));
-    reply->setProperty(DocsetNameProperty, name);
-    reply->setProperty(DownloadTypeProperty, DownloadDocset);
-    reply->setProperty(ListItemIndexProperty,
-                       ui->availableDocsetList->row(findDocsetListItem(name)));
+    updateDocset({QUrl(urlString.arg(name))}, name, priority);
 }
 
 void DocsetsDialog::removeDocset(const QString &name)
@@ -704,26 +800,203 @@ void DocsetsDialog::removeDocset(const QString &name)
     }
 }
 
+/*!
+  \internal
+  Starts extracting archive of docset \a docsetName written into \a stream into a staging
+  directory. The installed version of the docset stays in use until the new one replaces it.
+
+  If a previous extraction of the docset is still running, for example when a failed download
+  is retried before its extraction has noticed, the new one is started once it has finished.
+*/
+void DocsetsDialog::extractArchive(const QString &docsetName,
+                                   const QSharedPointer<Core::ArchiveStream> &stream)
+{
+    const QString stagingDirectoryName = docsetName + QLatin1String(".docset")
+            + QLatin1String(StagingDirectorySuffix);
+
+    if (m_archiveStreams.contains(docsetName)) {
+        // Data received in the meantime is buffered by the stream.
+        m_pendingArchiveStreams.insert(docsetName, stream);
+        return;
+    }
+
+    // Left behind by an interrupted installation.
+    removeStagedDocset(docsetName);
+
+    m_archiveStreams.insert(docsetName, stream);
+
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this,
+            [this, watcher, docsetName, stream] {
+        watcher->deleteLater();
+
+        const QString errorString = watcher->result();
+        if (errorString.isEmpty()) {
+            Core::Download::removeFile(
+                        cacheLocation(docsetName + QLatin1String(PartialDownloadFileSuffix)));
+            // The stream is kept registered until the docset is installed.
+            extractionCompleted(docsetName);
+            return;
+        }
+
+        m_archiveStreams.remove(docsetName);
+
+        const QSharedPointer<Core::ArchiveStream> pendingStream
+                = m_pendingArchiveStreams.take(docsetName);
+        if (pendingStream && !pendingStream->isAborted()) {
+            // The staging directory is free for the retried download.
+            extractArchive(docsetName, pendingStream);
+        } else if (!stream->isAborted()) {
+            // Resuming a broken archive would fail again.
+            Core::Download::removeFile(
+                        cacheLocation(docsetName + QLatin1String(PartialDownloadFileSuffix)));
+            extractionError(docsetName, errorString);
+        } else {
+            // Download has failed or has been cancelled, and is not being retried.
+            removeStagedDocset(docsetName);
+        }
+    });
+
+    watcher->setFuture(m_application->extract(stream, m_application->settings()->docsetPath,
+                                              stagingDirectoryName));
+}
+
+/*!
+  \internal
+  Verifies docset \a docsetName extracted into the staging directory, and installs it.
+*/
+void DocsetsDialog::extractionCompleted(const QString &docsetName)
+{
+    const QDir dataDir(m_application->settings()->docsetPath);
+    const QString stagingPath = dataDir.filePath(docsetName + QLatin1String(".docset")
+                                                 + QLatin1String(StagingDirectorySuffix));
+
+    // Write metadata about docset
+    Registry::DocsetMetadata metadata = m_availableDocsets.contains(docsetName)
+            ? m_availableDocsets[docsetName]
+              : m_userFeeds[docsetName];
+    metadata.save(stagingPath, metadata.latestVersion());
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, docsetName] {
+        watcher->deleteLater();
+
+        m_archiveStreams.remove(docsetName);
+
+        if (!watcher->result()) {
+            extractionError(docsetName, tr("Archive does not contain a valid docset."));
+            return;
+        }
+
+        installStagedDocset(docsetName);
+    });
+
+    // Opening the docset also prepares its index, so that loading the installed copy is quick.
+    watcher->setFuture(QtConcurrent::run([stagingPath] {
+        return Registry::Docset(stagingPath).isValid();
+    }));
+}
+
+/*!
+  \internal
+  Replaces the installed version of docset \a docsetName with the staged one. The registry
+  switches to the new version once it is loaded, and searches the previous one until then.
+*/
+void DocsetsDialog::installStagedDocset(const QString &docsetName)
+{
+    const QDir dataDir(m_application->settings()->docsetPath);
+    const QString docsetPath = dataDir.filePath(docsetName + QLatin1String(".docset"));
+    const QString stagingPath = docsetPath + QLatin1String(StagingDirectorySuffix);
+
+    QListWidgetItem *listItem = findDocsetListItem(docsetName);
+    if (listItem)
+        listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
+
+    resetProgress();
+
+    // The previous version is renamed away and deleted in the background. Files that are in use
+    // cannot be renamed on some platforms, unload it then.
+    Core::FileManager *fileManager = m_application->fileManager();
+    if (QFileInfo(docsetPath).isDir() && !fileManager->removeRecursively(docsetPath)) {
+        if (m_docsetRegistry->contains(docsetName))
+            m_docsetRegistry->unloadDocset(docsetName);
+
+        if (!fileManager->removeRecursively(docsetPath)) {
+            QMessageBox::warning(this, QStringLiteral("Zeal"),
+                                 tr("Cannot remove directory <b>%1</b>! It might be in use"
+                                    " by another process.").arg(docsetPath));
+            removeStagedDocset(docsetName);
+            return;
+        }
+    }
+
+    if (!QDir().rename(stagingPath, docsetPath)) {
+        QMessageBox::warning(this, QStringLiteral("Zeal"),
+                             tr("Cannot install docset <b>%1</b>.").arg(docsetName));
+        removeStagedDocset(docsetName);
+        return;
+    }
+
+    m_docsetRegistry->loadDocset(docsetPath);
+
+    if (listItem)
+        listItem->setHidden(true);
+
+    updateSavedSpace();
+}
+
+void DocsetsDialog::extractionError(const QString &docsetName, const QString &errorString)
+{
+    QMessageBox::warning(this, QStringLiteral("Zeal"),
+                         tr("Cannot extract docset <b>%1</b>: %2").arg(docsetName, errorString));
+
+    QListWidgetItem *listItem = findDocsetListItem(docsetName);
+    if (listItem)
+        listItem->setData(ProgressItemDelegate::ShowProgressRole, false);
+
+    // Do not leave a partially extracted docset behind.
+    removeStagedDocset(docsetName);
+}
+
+void DocsetsDialog::removeStagedDocset(const QString &docsetName)
+{
+    const QString stagingPath = QDir(m_application->settings()->docsetPath)
+            .filePath(docsetName + QLatin1String(".docset") + QLatin1String(StagingDirectorySuffix));
+    if (QFileInfo(stagingPath).isDir())
+        m_application->fileManager()->removeRecursively(stagingPath);
+}
+
 void DocsetsDialog::updateCombinedProgress()
 {
-    if (m_replies.isEmpty()) {
+    if (m_replies.isEmpty() && m_downloads.isEmpty() && m_deltaUpdates.isEmpty()) {
         resetProgress();
         return;
     }
 
+    const Core::DownloadManager *downloadManager = m_application->downloadManager();
+    qint64 received = m_combinedReceived + downloadManager->bytesReceived();
+    qint64 total = m_combinedTotal + downloadManager->bytesTotal();
+
+    for (const Core::DeltaUpdate *update : m_deltaUpdates) {
+        received += update->bytesReceived();
+        total += update->bytesTotal();
+    }
+
     ui->combinedProgressBar->show();
-    ui->combinedProgressBar->setValue(percent(m_combinedReceived, m_combinedTotal));
+    ui->combinedProgressBar->setValue(percent(received, total));
+    ui->combinedProgressBar->setFormat(downloadStatistics());
     ui->cancelButton->show();
 }
 
 void DocsetsDialog::resetProgress()
 {
-    if (!m_replies.isEmpty())
+    if (!m_replies.isEmpty() || !m_downloads.isEmpty() || !m_deltaUpdates.isEmpty())
         return;
 
     ui->cancelButton->hide();
     ui->combinedProgressBar->hide();
     ui->combinedProgressBar->setValue(0);
+    ui->combinedProgressBar->setFormat(QStringLiteral("%p%"));
 
     m_combinedReceived = 0;
     m_combinedTotal = 0;
@@ -747,15 +1020,87 @@ void DocsetsDialog::resetProgress()
     ui->refreshButton->setEnabled(true);
 }
 
-QString DocsetsDialog::docsetNameForTmpFilePath(const QString &filePath) const
+/*!
+  \internal
+  Shows disk space saved by sharing identical files between docsets, with a breakdown per docset
+  in the tooltip. Sizes are collected in a worker thread.
+*/
+void DocsetsDialog::updateSavedSpace()
 {
-    for (auto it = m_tmpFiles.cbegin(), end = m_tmpFiles.cend(); it != end; ++it) {
-        if (it.value()->fileName() == filePath) {
-            return it.key();
+    if (!m_application->settings()->deduplicateDocsetFiles)
+        return;
+
+    QMap<QString, QString> docsetPaths;
+    for (const Registry::Docset *docset : m_docsetRegistry->docsets())
+        docsetPaths.insert(docset->title(), docset->path());
+
+    typedef QMap<QString, qint64> SizeMap;
+    QFutureWatcher<SizeMap> *watcher = new QFutureWatcher<SizeMap>(this);
+    connect(watcher, &QFutureWatcher<SizeMap>::finished, this, [this, watcher] {
+        watcher->deleteLater();
+
+        const auto formatSize = [](qint64 size) {
+            return size >= 1024 * 1024 * 1024
+                    ? tr("%1 GB").arg(size / (1024.0 * 1024.0 * 1024.0), 0, 'f', 1)
+                    : tr("%1 MB").arg(size / (1024.0 * 1024.0), 0, 'f', 1);
+        };
+
+        const SizeMap sizes = watcher->result();
+
+        QList<QPair<qint64, QString>> docsetSizes;
+        qint64 total = 0;
+        for (auto it = sizes.cbegin(); it != sizes.cend(); ++it) {
+            total += it.value();
+            if (it.value() > 0)
+                docsetSizes.append({it.value(), it.key()});
         }
-    }
 
-    return QString();
+        if (total <= 0) {
+            ui->savedSpaceLabel->hide();
+            return;
+        }
+
+        std::sort(docsetSizes.begin(), docsetSizes.end(), std::greater<QPair<qint64, QString>>());
+
+        QStringList lines;
+        for (const QPair<qint64, QString> &docsetSize : docsetSizes)
+            lines.append(tr("%1: %2").arg(docsetSize.second, formatSize(docsetSize.first)));
+
+        ui->savedSpaceLabel->setText(tr("Shared files save %1").arg(formatSize(total)));
+        ui->savedSpaceLabel->setToolTip(lines.join(QLatin1Char('\n')));
+        ui->savedSpaceLabel->show();
+    });
+
+    watcher->setFuture(QtConcurrent::run([docsetPaths] {
+        SizeMap sizes;
+        for (auto it = docsetPaths.cbegin(); it != docsetPaths.cend(); ++it)
+            sizes.insert(it.key(), Core::ContentStore::savedSize(it.value()));
+        return sizes;
+    }));
+}
+
+/*!
+  \internal
+  Returns progress bar format with the combined speed and remaining time of docset downloads.
+*/
+QString DocsetsDialog::downloadStatistics() const
+{
+    const Core::DownloadManager *downloadManager = m_application->downloadManager();
+
+    const qint64 throughput = downloadManager->throughput();
+    const int remainingTime = downloadManager->remainingTime();
+    if (m_downloads.isEmpty() || throughput <= 0 || remainingTime < 0)
+        return QStringLiteral("%p%");
+
+    const QString speed = throughput >= 1024 * 1024
+            ? tr("%1 MB/s").arg(throughput / (1024.0 * 1024.0), 0, 'f', 1)
+            : tr("%1 KB/s").arg(throughput / 1024);
+
+    const QString time = remainingTime >= 60
+            ? tr("%n min left", nullptr, (remainingTime + 59) / 60)
+            : tr("%n s left", nullptr, remainingTime);
+
+    return tr("%p% (%1, %2)").arg(speed, time);
 }
 
 int DocsetsDialog::percent(qint64 fraction, qint64 total)
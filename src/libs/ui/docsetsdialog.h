@@ -24,15 +24,16 @@
 #ifndef ZEAL_WIDGETUI_DOCSETSDIALOG_H
 #define ZEAL_WIDGETUI_DOCSETSDIALOG_H
 
+#include <core/download.h>
 #include <registry/docsetmetadata.h>
 
 #include <QDialog>
 #include <QHash>
 #include <QMap>
+#include <QSharedPointer>
 
 class QListWidgetItem;
 class QNetworkReply;
-class QTemporaryFile;
 class QUrl;
 
 
@@ -44,6 +45,8 @@ class DocsetRegistry;
 
 namespace Core {
 class Application;
+class ArchiveStream;
+class DeltaUpdate;
 }
 
 namespace WidgetUi {
@@ -73,16 +76,11 @@ private slots:
     void downloadCompleted();
     void downloadProgress(qint64 received, qint64 total);
 
-    void extractionCompleted(const QString &filePath);
-    void extractionError(const QString &filePath, const QString &errorString);
-    void extractionProgress(const QString &filePath, qint64 extracted, qint64 total);
-
     void loadDocsetList();
 
 private:
     enum DownloadType {
         DownloadDashFeed,
-        DownloadDocset,
         DownloadDocsetList
     };
 
@@ -91,6 +89,8 @@ private:
     Registry::DocsetRegistry *m_docsetRegistry = nullptr;
 
     QList<QNetworkReply *> m_replies;
+    // Docset downloads are queued by Core::DownloadManager.
+    QList<Core::Download *> m_downloads;
     qint64 m_combinedTotal = 0;
     qint64 m_combinedReceived = 0;
 
@@ -98,25 +98,43 @@ private:
     QMap<QString, Registry::DocsetMetadata> m_availableDocsets;
     QMap<QString, Registry::DocsetMetadata> m_userFeeds;
 
-    QHash<QString, QTemporaryFile *> m_tmpFiles;
+    // Updates of installed docsets that only download changed chunks.
+    QHash<QString, Core::DeltaUpdate *> m_deltaUpdates;
+
+    // Docset archives are extracted while they are being downloaded.
+    QHash<QString, QSharedPointer<Core::ArchiveStream>> m_archiveStreams;
+    // Retried downloads waiting for the previous extraction to leave the staging directory.
+    QHash<QString, QSharedPointer<Core::ArchiveStream>> m_pendingArchiveStreams;
 
     QListWidgetItem *findDocsetListItem(const QString &name) const;
     bool updatesAvailable() const;
 
     QNetworkReply *download(const QUrl &url);
+    Core::Download *downloadDocset(const QList<QUrl> &urls, const QString &name,
+                                   Core::Download::Priority priority);
+    void updateDocset(const QList<QUrl> &urls, const QString &name,
+                      Core::Download::Priority priority);
+    void docsetDownloadCompleted(Core::Download *download);
     void cancelDownloads();
+    void disableControls();
 
     void downloadDocsetList();
     void processDocsetList(const QJsonArray &list);
 
-    void downloadDashDocset(const QModelIndex &index);
+    void downloadDashDocset(const QModelIndex &index, Core::Download::Priority priority);
     void removeDocset(const QString &name);
 
+    void extractArchive(const QString &docsetName,
+                        const QSharedPointer<Core::ArchiveStream> &stream);
+    void extractionCompleted(const QString &docsetName);
+    void extractionError(const QString &docsetName, const QString &errorString);
+    void installStagedDocset(const QString &docsetName);
+    void removeStagedDocset(const QString &docsetName);
+
     void updateCombinedProgress();
     void resetProgress();
-
-    // FIXME: Come up with a better approach
-    QString docsetNameForTmpFilePath(const QString &filePath) const;
+    void updateSavedSpace();
+    QString downloadStatistics() const;
 
     static inline int percent(qint64 fraction, qint64 total);
 
@@ -37,10 +37,13 @@
 #include <registry/itemdatarole.h>
 #include <registry/listmodel.h>
 #include <registry/searchmodel.h>
+#include <util/packfile.h>
 
 #include <QCloseEvent>
 #include <QDesktopServices>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QKeyEvent>
 #include <QMenu>
 #include <QMessageBox>
@@ -49,9 +52,13 @@
 #include <QSystemTrayIcon>
 #include <QTabBar>
 #include <QTimer>
+#include <QWebElement>
 #include <QWebFrame>
 #include <QWebHistory>
 #include <QWebPage>
+#include <QWebSecurityOrigin>
+
+#include <QtConcurrent>
 
 using namespace Zeal;
 using namespace Zeal::WidgetUi;
@@ -61,6 +68,27 @@ const char WelcomePageUrl[] = "qrc:///browser/welcome.html";
 const char WelcomePageNoAdUrl[] = "qrc:///browser/welcome-noad.html";
 const char DarkModeCssUrl[] = ":/browser/assets/css/darkmode.css";
 const char HighlightOnNavigateCssUrl[] = ":/browser/assets/css/highlight.css";
+
+// Bounds of the delay before the top search result is opened, in milliseconds.
+const int MinOpenDocsetDelay = 150;
+const int MaxOpenDocsetDelay = 1000;
+
+const int HibernateTabsInterval = 60000; // 1 minute
+
+// Number of top search results loaded in background pages.
+const int PreloadedResultCount = 1;
+
+// Number of pages linked from the current one to look up TOC for.
+const int PrefetchedTocCount = 10;
+
+// Rows leading to the index from the top level, which stay meaningful after a model reset.
+QList<int> indexPath(QModelIndex index)
+{
+    QList<int> path;
+    for (; index.isValid(); index = index.parent())
+        path.prepend(index.row());
+    return path;
+}
 }
 
 namespace Zeal {
@@ -73,27 +101,28 @@ struct TabState
         searchModel = new Registry::SearchModel();
         tocModel = new Registry::SearchModel();
 
-        webPage = new QWebPage();
-        webPage->setLinkDelegationPolicy(QWebPage::DelegateExternalLinks);
-        webPage->setNetworkAccessManager(Core::Application::instance()->networkManager());
+        setWebPage(createWebPage());
+        inactivityTimer.start();
     }
 
     TabState(const TabState &other)
         : searchQuery(other.searchQuery)
-        , selections(other.selections)
+        , selectionPaths(other.selectionPaths)
         , expansions(other.expansions)
         , searchScrollPosition(other.searchScrollPosition)
         , tocScrollPosition(other.tocScrollPosition)
         , webViewZoomFactor(other.webViewZoomFactor)
     {
+        // Models share the implicitly shared result lists, nothing is copied here.
         searchModel = new Registry::SearchModel(*other.searchModel);
         tocModel = new Registry::SearchModel(*other.tocModel);
 
-        webPage = new QWebPage();
-        webPage->setLinkDelegationPolicy(QWebPage::DelegateExternalLinks);
-        webPage->setNetworkAccessManager(Core::Application::instance()->networkManager());
+        setWebPage(createWebPage());
+        inactivityTimer.start();
 
         restoreHistory(other.saveHistory());
+        if (other.pendingUrl.isValid())
+            loadUrl(other.pendingUrl);
     }
 
     ~TabState()
@@ -101,7 +130,41 @@ struct TabState
         delete searchModel;
         delete tocModel;
         // deleteLater() prevents crashing on quit (#577)
-        webPage->deleteLater();
+        if (webPage)
+            releaseWebPage(webPage);
+    }
+
+    // Deletes page later, without letting it call back into the tab in the meantime. Only
+    // connections made by the tab are dropped, the view may still watch the page for deletion.
+    static void releaseWebPage(QWebPage *page)
+    {
+        QObject::disconnect(page, nullptr, page, nullptr);
+        page->deleteLater();
+    }
+
+    static QWebPage *createWebPage()
+    {
+        QWebPage *page = new QWebPage();
+        page->setLinkDelegationPolicy(QWebPage::DelegateExternalLinks);
+        page->setNetworkAccessManager(Core::Application::instance()->networkManager());
+        return page;
+    }
+
+    void setWebPage(QWebPage *page)
+    {
+        if (webPage)
+            releaseWebPage(webPage);
+
+        webPage = page;
+
+        // Bring back the scroll position of a page restored after hibernation.
+        QObject::connect(page, &QWebPage::loadFinished, page, [this, page](bool ok) {
+            if (!ok || webScrollPosition.isNull())
+                return;
+
+            page->mainFrame()->setScrollPosition(webScrollPosition);
+            webScrollPosition = QPoint();
+        });
     }
 
     void restoreHistory(const QByteArray &array) const
@@ -112,6 +175,9 @@ struct TabState
 
     QByteArray saveHistory() const
     {
+        if (isHibernated())
+            return hibernatedHistory;
+
         QByteArray array;
         QDataStream stream(&array, QIODevice::WriteOnly);
         stream << *webPage->history();
@@ -119,26 +185,78 @@ struct TabState
     }
 
     QUrl url() const {
+        if (isHibernated())
+            return pendingUrl.isValid() ? pendingUrl : hibernatedUrl;
+
         return webPage->mainFrame()->url();
     }
 
     void loadUrl(const QUrl &url)
     {
+        if (isHibernated()) {
+            pendingUrl = url;
+            return;
+        }
+
         webPage->mainFrame()->load(url);
     }
 
     QString title() const
     {
+        if (isHibernated())
+            return hibernatedTitle;
+
         return webPage->mainFrame()->title();
     }
 
+    bool isHibernated() const
+    {
+        return webPage == nullptr;
+    }
+
+    // Frees the page keeping only what is needed to restore it in wake().
+    void hibernate()
+    {
+        if (isHibernated())
+            return;
+
+        hibernatedHistory = saveHistory();
+        hibernatedUrl = url();
+        hibernatedTitle = title();
+        webScrollPosition = webPage->mainFrame()->scrollPosition();
+
+        releaseWebPage(webPage);
+        webPage = nullptr;
+    }
+
+    void wake()
+    {
+        if (!isHibernated())
+            return;
+
+        setWebPage(createWebPage());
+
+        // Restoring history loads the current item.
+        restoreHistory(hibernatedHistory);
+        if (pendingUrl.isValid()) {
+            webScrollPosition = QPoint();
+            loadUrl(pendingUrl);
+        }
+
+        hibernatedHistory.clear();
+        pendingUrl.clear();
+    }
+
     QString searchQuery;
 
     // Content/Search results tree view state
     Registry::SearchModel *searchModel = nullptr;
-    QModelIndexList selections;
+    // Search results of background tabs are released, so selections are kept as row paths.
+    QList<QList<int>> selectionPaths;
     QModelIndexList expansions;
     int searchScrollPosition = 0;
+    // Set while results released in background are being restored.
+    bool restoringSearchResults = false;
 
     // TOC list view state
     Registry::SearchModel *tocModel = nullptr;
@@ -146,6 +264,14 @@ struct TabState
 
     QWebPage *webPage = nullptr;
     int webViewZoomFactor = 0;
+
+    // Hibernation state
+    QElapsedTimer inactivityTimer;
+    QByteArray hibernatedHistory;
+    QUrl hibernatedUrl;
+    QString hibernatedTitle;
+    QUrl pendingUrl; // Requested while hibernated.
+    QPoint webScrollPosition;
 };
 
 } // namespace WidgetUi
@@ -158,10 +284,16 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     m_settings(app->settings()),
     m_zealListModel(new Registry::ListModel(app->docsetRegistry(), this)),
     m_globalShortcut(new QxtGlobalShortcut(m_settings->showShortcut, this)),
-    m_openDocsetTimer(new QTimer(this))
+    m_openDocsetTimer(new QTimer(this)),
+    m_hibernateTabsTimer(new QTimer(this))
 {
     ui->setupUi(this);
 
+    m_preloadPages.resize(PreloadedResultCount);
+
+    // Pages served from docset packs must be able to load each other like local files.
+    QWebSecurityOrigin::addLocalScheme(Util::PackFile::urlScheme());
+
     // initialise key grabber
     connect(m_globalShortcut, &QxtGlobalShortcut::activated, this, &MainWindow::toggleWindow);
 
@@ -292,9 +424,9 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     setupSearchBoxCompletions();
     SearchItemDelegate *delegate = new SearchItemDelegate(ui->treeView);
     delegate->setDecorationRoles({Registry::ItemDataRole::DocsetIconRole, Qt::DecorationRole});
-    connect(ui->lineEdit, &QLineEdit::textChanged, [delegate](const QString &text) {
-        delegate->setHighlight(Registry::SearchQuery::fromString(text).query());
-    });
+    // Results are laid out without measuring each row.
+    delegate->setUniformRowHeights(true);
+    ui->treeView->setUniformRowHeights(true);
     ui->treeView->setItemDelegate(delegate);
 
     ui->tocListView->setItemDelegate(new SearchItemDelegate(ui->tocListView));
@@ -315,12 +447,17 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
 
         Registry::Docset *docset = m_application->docsetRegistry()->docset(name);
         if (docset)
-            currentTabState()->tocModel->setResults(docset->relatedLinks(url));
+            updateToc(docset, url);
 
         ui->actionBack->setEnabled(ui->webView->canGoBack());
         ui->actionForward->setEnabled(ui->webView->canGoForward());
     });
 
+    connect(ui->webView, &SearchableWebView::loadFinished, this, [this](bool ok) {
+        if (ok)
+            prefetchToc();
+    });
+
     connect(ui->webView, &SearchableWebView::titleChanged, [this](const QString &title) {
         if (title.isEmpty())
             return;
@@ -338,7 +475,11 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     });
 
     connect(m_application->docsetRegistry(), &Registry::DocsetRegistry::searchCompleted,
-            this, [this](const QList<Registry::SearchResult> &results) {
+            this, [this](const QString &query, const QList<Registry::SearchResult> &results) {
+        // Late results of a query from the previously active tab.
+        if (query != currentTabState()->searchQuery)
+            return;
+
         currentTabState()->searchModel->setResults(results);
     });
 
@@ -377,19 +518,35 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
         setupSearchBoxCompletions();
     });
 
+    // An updated docset has been installed, results from the previous version stay shown.
+    connect(m_application->docsetRegistry(), &Registry::DocsetRegistry::docsetReplaced,
+            this, [this](const QString &name, Registry::Docset *previousDocset) {
+        Registry::Docset *docset = m_application->docsetRegistry()->docset(name);
+        for (TabState *tabState : m_tabStates) {
+            tabState->searchModel->replaceDocset(previousDocset, docset);
+            tabState->tocModel->replaceDocset(previousDocset, docset);
+        }
+
+        setupSearchBoxCompletions();
+    });
+
     connect(ui->lineEdit, &QLineEdit::textChanged, [this](const QString &text) {
         if (text == currentTabState()->searchQuery)
             return;
 
         currentTabState()->searchQuery = text;
+        currentTabState()->restoringSearchResults = false;
         m_application->docsetRegistry()->search(text);
     });
 
     // Setup delayed navigation to a page until user makes a pause in typing a search query.
+    // The delay is adjusted to the search latency in queryCompleted().
     m_openDocsetTimer->setInterval(400);
     m_openDocsetTimer->setSingleShot(true);
     connect(m_openDocsetTimer, &QTimer::timeout, this, [this]() {
-        QModelIndex index = m_openDocsetTimer->property("index").toModelIndex();
+        // Persistent, so that released or replaced results invalidate the index.
+        const QPersistentModelIndex index
+                = m_openDocsetTimer->property("index").value<QPersistentModelIndex>();
         if (!index.isValid())
             return;
 
@@ -427,7 +584,7 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
 
     connect(ui->openUrlButton, &QPushButton::clicked, [this]() {
         const QUrl url(ui->webView->page()->history()->currentItem().url());
-        if (url.scheme() != QLatin1String("qrc"))
+        if (url.scheme() != QLatin1String("qrc") && url.scheme() != Util::PackFile::urlScheme())
             QDesktopServices::openUrl(url);
     });
 
@@ -451,6 +608,10 @@ MainWindow::MainWindow(Core::Application *app, QWidget *parent) :
     ui->tocListView->setAttribute(Qt::WA_MacShowFocusRect, false);
 #endif
 
+    m_hibernateTabsTimer->setInterval(HibernateTabsInterval);
+    connect(m_hibernateTabsTimer, &QTimer::timeout, this, &MainWindow::hibernateTabs);
+    m_hibernateTabsTimer->start();
+
     connect(m_settings, &Core::Settings::updated, this, &MainWindow::applySettings);
     applySettings();
 
@@ -466,6 +627,11 @@ MainWindow::~MainWindow()
     // Delete the UI first, because it depends on tab states.
     delete ui;
     qDeleteAll(m_tabStates);
+
+    for (QWebPage *page : m_preloadPages) {
+        if (page)
+            page->deleteLater();
+    }
 }
 
 void MainWindow::search(const Registry::SearchQuery &query)
@@ -483,10 +649,163 @@ void MainWindow::openDocset(const QModelIndex &index)
     if (url.isNull())
         return;
 
-    ui->webView->load(url.toUrl());
+    if (!showPreloadedPage(url.toUrl()))
+        ui->webView->load(url.toUrl());
+
     ui->webView->focus();
 }
 
+/*!
+  \internal
+  Starts loading top search results of the current tab in hidden pages.
+
+  Pages are loaded on top of the tab history, so that a preloaded page can replace the tab page
+  in showPreloadedPage() without losing back and forward navigation.
+*/
+void MainWindow::preloadResults()
+{
+    TabState *tabState = currentTabState();
+    const QByteArray history = tabState->saveHistory();
+    const bool isHistoryChanged = tabState != m_preloadTabState || history != m_preloadHistory;
+
+    m_preloadTabState = tabState;
+    m_preloadHistory = history;
+
+    const Registry::SearchModel *model = tabState->searchModel;
+    for (int i = 0; i < m_preloadPages.size() && i < model->rowCount(); ++i) {
+        const QUrl url = model->index(i, 0).data(Registry::ItemDataRole::UrlRole).toUrl();
+
+        QWebPage *&page = m_preloadPages[i];
+        if (!page)
+            page = TabState::createWebPage();
+        else if (!isHistoryChanged && page->mainFrame()->requestedUrl() == url)
+            continue;
+
+        page->setViewportSize(ui->webView->size());
+
+        QDataStream stream(history);
+        stream >> *page->history();
+        page->mainFrame()->load(url);
+    }
+}
+
+/*!
+  \internal
+  Replaces the current tab page with a page preloaded for \a url. Returns \c false if there is
+  no such page, or it has been preloaded before the tab navigated elsewhere.
+*/
+bool MainWindow::showPreloadedPage(const QUrl &url)
+{
+    TabState *tabState = currentTabState();
+    if (tabState != m_preloadTabState || tabState->saveHistory() != m_preloadHistory)
+        return false;
+
+    for (QWebPage *&page : m_preloadPages) {
+        if (!page || page->mainFrame()->requestedUrl() != url)
+            continue;
+
+        tabState->setWebPage(page);
+        page = nullptr;
+
+        // Remaining pages have been preloaded on top of the replaced page history.
+        m_preloadTabState = nullptr;
+
+        ui->webView->setPage(tabState->webPage);
+        ui->webView->setZoomFactor(tabState->webViewZoomFactor);
+
+        // The view was not connected to the page when the load was committed.
+        const QWebFrame *frame = tabState->webPage->mainFrame();
+        if (!frame->url().isEmpty())
+            emit ui->webView->urlChanged(frame->url());
+        if (!frame->title().isEmpty())
+            emit ui->webView->titleChanged(frame->title());
+
+        return true;
+    }
+
+    return false;
+}
+
+/*!
+  \internal
+  Fills TOC of the current tab with links related to \a url. Unless the links are cached by the
+  \a docset, they are looked up in a worker thread and the TOC is updated when ready.
+*/
+void MainWindow::updateToc(Registry::Docset *docset, const QUrl &url)
+{
+    TabState *tabState = currentTabState();
+
+    if (docset->hasCachedRelatedLinks(url)) {
+        tabState->tocModel->setResults(docset->relatedLinks(url));
+        return;
+    }
+
+    // Keeps the docset alive while the lookup is running, even if it gets unloaded.
+    const QString name = docset->name();
+    const QSharedPointer<Registry::Docset> sharedDocset
+            = m_application->docsetRegistry()->sharedDocset(name);
+
+    using Watcher = QFutureWatcher<QList<Registry::SearchResult>>;
+    Watcher *watcher = new Watcher(this);
+    connect(watcher, &Watcher::finished, this, [this, watcher, tabState, docset, name, url]() {
+        watcher->deleteLater();
+
+        // Tab could have been closed or navigated elsewhere in the meantime.
+        if (!m_tabStates.contains(tabState) || tabState->url() != url)
+            return;
+
+        // Results refer to the docset, which could have been unloaded.
+        if (m_application->docsetRegistry()->docset(name) != docset)
+            return;
+
+        tabState->tocModel->setResults(watcher->result());
+    });
+
+    watcher->setFuture(QtConcurrent::run([sharedDocset, url] {
+        return sharedDocset->relatedLinks(url);
+    }));
+}
+
+/*!
+  \internal
+  Looks up TOC for pages of the same docset linked from the current page in background,
+  so that it is ready when the user follows a link.
+*/
+void MainWindow::prefetchToc()
+{
+    const QWebFrame *frame = ui->webView->page()->mainFrame();
+    const QString name = docsetName(frame->url());
+
+    const QSharedPointer<Registry::Docset> docset
+            = m_application->docsetRegistry()->sharedDocset(name);
+    if (!docset)
+        return;
+
+    QList<QUrl> urls;
+    for (const QWebElement &element : frame->findAllElements(QStringLiteral("a[href]"))) {
+        QUrl url = frame->baseUrl().resolved(QUrl(element.attribute(QStringLiteral("href"))));
+        url.setFragment(QString());
+
+        const bool isDocsetPage = url.isLocalFile() || url.scheme() == Util::PackFile::urlScheme();
+        if (!isDocsetPage || url.path() == frame->url().path() || urls.contains(url)
+                || docsetName(url) != name || docset->hasCachedRelatedLinks(url)) {
+            continue;
+        }
+
+        urls.append(url);
+        if (urls.size() == PrefetchedTocCount)
+            break;
+    }
+
+    if (urls.isEmpty())
+        return;
+
+    QtConcurrent::run([docset, urls] {
+        for (const QUrl &url : urls)
+            docset->relatedLinks(url);
+    });
+}
+
 QString MainWindow::docsetName(const QUrl &url) const
 {
     const QRegExp docsetRegex(QStringLiteral("/([^/]+)[.]docset"));
@@ -501,13 +820,40 @@ QIcon MainWindow::docsetIcon(const QString &docsetName) const
 
 void MainWindow::queryCompleted()
 {
+    TabState *tabState = currentTabState();
+
+    // Ignore models of background tabs.
+    if (sender() != tabState->searchModel)
+        return;
+
     m_openDocsetTimer->stop();
 
     syncTreeView();
 
-    ui->treeView->setCurrentIndex(currentTabState()->searchModel->index(0, 0, QModelIndex()));
+    if (tabState->restoringSearchResults) {
+        tabState->restoringSearchResults = false;
+        restoreSelections();
+
+        // Bring back the view state instead of navigating away from the current page.
+        Registry::SearchModel *model = tabState->searchModel;
+        while (model->rowCount() <= tabState->searchScrollPosition
+               && model->canFetchMore(QModelIndex())) {
+            model->fetchMore(QModelIndex());
+        }
+
+        ui->treeView->verticalScrollBar()->setValue(tabState->searchScrollPosition);
+        return;
+    }
+
+    ui->treeView->setCurrentIndex(tabState->searchModel->index(0, 0, QModelIndex()));
+    preloadResults();
 
-    m_openDocsetTimer->setProperty("index", ui->treeView->currentIndex());
+    // A pause in typing is only meaningful if it is longer than a search takes.
+    const int latency = m_application->docsetRegistry()->searchLatency();
+    m_openDocsetTimer->setInterval(qBound(MinOpenDocsetDelay, MinOpenDocsetDelay + 2 * latency,
+                                          MaxOpenDocsetDelay));
+    m_openDocsetTimer->setProperty("index", QVariant::fromValue(
+                                       QPersistentModelIndex(ui->treeView->currentIndex())));
     m_openDocsetTimer->start();
 }
 
@@ -519,7 +865,10 @@ void MainWindow::closeTab(int index)
     if (index == -1)
         return;
 
-    delete m_tabStates.takeAt(index);
+    TabState *tabState = m_tabStates.takeAt(index);
+    if (tabState == m_preloadTabState)
+        m_preloadTabState = nullptr;
+    delete tabState;
 
     m_tabBar->removeTab(index);
 
@@ -588,6 +937,36 @@ void MainWindow::syncTreeView()
     ui->treeView->reset();
 }
 
+/*!
+  \internal
+  Selects the items saved when the current tab was left, if the tree view still has them.
+*/
+void MainWindow::restoreSelections()
+{
+    const TabState *tabState = currentTabState();
+    QAbstractItemModel *model = ui->treeView->model();
+
+    ui->treeView->blockSignals(true);
+    for (const QList<int> &path : tabState->selectionPaths) {
+        QModelIndex index;
+        for (int row : path) {
+            // Search results are fetched in batches.
+            while (model->rowCount(index) <= row && model->canFetchMore(index))
+                model->fetchMore(index);
+
+            index = model->index(row, 0, index);
+            if (!index.isValid())
+                break;
+        }
+
+        if (index.isValid()) {
+            ui->treeView->selectionModel()->select(index, QItemSelectionModel::Select
+                                                   | QItemSelectionModel::Rows);
+        }
+    }
+    ui->treeView->blockSignals(false);
+}
+
 void MainWindow::syncToc()
 {
     if (!currentTabState()->tocModel->isEmpty()) {
@@ -599,6 +978,42 @@ void MainWindow::syncToc()
 
 }
 
+/*!
+  \internal
+  Unloads pages of background tabs that have been inactive for longer than the configured
+  timeout, or that exceed the maximum number of loaded tabs, least recently used first.
+*/
+void MainWindow::hibernateTabs()
+{
+    if (m_tabBar->currentIndex() == -1)
+        return;
+
+    const TabState *currentTab = currentTabState();
+
+    QList<TabState *> loadedTabs;
+    for (TabState *tabState : m_tabStates) {
+        if (tabState != currentTab && !tabState->isHibernated())
+            loadedTabs.append(tabState);
+    }
+
+    // Most recently used first.
+    std::sort(loadedTabs.begin(), loadedTabs.end(), [](const TabState *a, const TabState *b) {
+        return a->inactivityTimer.elapsed() < b->inactivityTimer.elapsed();
+    });
+
+    const qint64 timeout = m_settings->tabUnloadTimeout * qint64(60000);
+
+    for (int i = 0; i < loadedTabs.size(); ++i) {
+        TabState *tabState = loadedTabs.at(i);
+
+        // The current tab counts towards the limit.
+        if ((m_settings->maxLoadedTabs > 0 && i + 1 >= m_settings->maxLoadedTabs)
+                || (timeout > 0 && tabState->inactivityTimer.hasExpired(timeout))) {
+            tabState->hibernate();
+        }
+    }
+}
+
 TabState *MainWindow::currentTabState() const
 {
     return m_tabStates.at(m_tabBar->currentIndex());
@@ -644,10 +1059,20 @@ void MainWindow::setupTabBar()
         const QVariant previousTabIndex = m_tabBar->property(PreviousTabIndexProperty);
         if (previousTabIndex.isValid() && previousTabIndex.toInt() < m_tabStates.size()) {
             TabState *previousTabState = m_tabStates.at(previousTabIndex.toInt());
-            previousTabState->selections = ui->treeView->selectionModel()->selectedIndexes();
+            previousTabState->selectionPaths.clear();
+            for (const QModelIndex &index : ui->treeView->selectionModel()->selectedRows())
+                previousTabState->selectionPaths.append(indexPath(index));
             previousTabState->searchScrollPosition = ui->treeView->verticalScrollBar()->value();
             previousTabState->tocScrollPosition = ui->tocListView->verticalScrollBar()->value();
             previousTabState->webViewZoomFactor = ui->webView->zoomFactor();
+            previousTabState->inactivityTimer.start();
+
+            // Background tabs keep only the query, results are restored on activation.
+            // A pending navigation to one of them must not open it in the new tab.
+            if (previousTabState != m_tabStates.at(index)) {
+                m_openDocsetTimer->stop();
+                previousTabState->searchModel->releaseResults();
+            }
         }
 
         // Load current tab state
@@ -660,14 +1085,22 @@ void MainWindow::setupTabBar()
         syncTreeView();
         syncToc();
 
-        // Bring back the selections and expansions
+        if (!tabState->searchQuery.isEmpty() && tabState->searchModel->isEmpty()) {
+            tabState->restoringSearchResults = true;
+            m_application->docsetRegistry()->search(tabState->searchQuery);
+        }
+
+        // Bring back the selections and expansions. Released search results are selected once
+        // they are restored.
+        if (!tabState->restoringSearchResults)
+            restoreSelections();
+
         ui->treeView->blockSignals(true);
-        for (const QModelIndex &selection: tabState->selections)
-            ui->treeView->selectionModel()->select(selection, QItemSelectionModel::Select);
         for (const QModelIndex &expandedIndex: tabState->expansions)
             ui->treeView->expand(expandedIndex);
         ui->treeView->blockSignals(false);
 
+        tabState->wake();
         ui->webView->setPage(tabState->webPage);
         ui->webView->setZoomFactor(tabState->webViewZoomFactor);
 
@@ -676,6 +1109,8 @@ void MainWindow::setupTabBar()
 
         ui->treeView->verticalScrollBar()->setValue(tabState->searchScrollPosition);
         ui->tocListView->verticalScrollBar()->setValue(tabState->tocScrollPosition);
+
+        hibernateTabs();
     });
     connect(m_tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeTab);
     connect(m_tabBar, &QTabBar::tabMoved, this, &MainWindow::moveTab);
@@ -852,6 +1287,9 @@ void MainWindow::applySettings()
 
     const QString cssUrl = QLatin1String("data:text/css;charset=utf-8;base64,") + ba.toBase64();
     QWebSettings::globalSettings()->setUserStyleSheetUrl(QUrl(cssUrl));
+
+    // Tabs
+    hibernateTabs();
 }
 
 void MainWindow::toggleWindow()
@@ -34,6 +34,7 @@ class QModelIndex;
 class QSystemTrayIcon;
 class QTabBar;
 class QTimer;
+class QWebPage;
 
 namespace Zeal {
 
@@ -43,6 +44,7 @@ class Settings;
 } // namespace Core
 
 namespace Registry {
+class Docset;
 class ListModel;
 } //namespace Registry
 
@@ -84,9 +86,15 @@ private slots:
 
 private:
     void syncTreeView();
+    void restoreSelections();
     void syncToc();
     void setupSearchBoxCompletions();
     void setupTabBar();
+    void hibernateTabs();
+    void updateToc(Zeal::Registry::Docset *docset, const QUrl &url);
+    void prefetchToc();
+    void preloadResults();
+    bool showPreloadedPage(const QUrl &url);
 
     TabState *currentTabState() const;
 
@@ -113,6 +121,12 @@ private:
     QSystemTrayIcon *m_trayIcon = nullptr;
 
     QTimer *m_openDocsetTimer = nullptr;
+    QTimer *m_hibernateTabsTimer = nullptr;
+
+    // Hidden pages with top search results, see preloadResults().
+    QVector<QWebPage *> m_preloadPages;
+    TabState *m_preloadTabState = nullptr;
+    QByteArray m_preloadHistory;
 };
 
 } // namespace WidgetUi
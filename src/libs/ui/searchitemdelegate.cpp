@@ -23,6 +23,8 @@
 
 #include "searchitemdelegate.h"
 
+#include <registry/itemdatarole.h>
+
 #include <QAbstractItemView>
 #include <QFontMetrics>
 #include <QHelpEvent>
@@ -31,8 +33,15 @@
 
 using namespace Zeal::WidgetUi;
 
+namespace {
+// Enough to cover the visible rows of a few full-screen views.
+const int TextCacheSize = 1000;
+}
+
 SearchItemDelegate::SearchItemDelegate(QObject *parent) :
-    QStyledItemDelegate(parent)
+    QStyledItemDelegate(parent),
+    m_textLayoutCache(TextCacheSize),
+    m_textWidthCache(TextCacheSize)
 {
 }
 
@@ -46,13 +55,29 @@ void SearchItemDelegate::setDecorationRoles(const QList<int> &roles)
     m_decorationRoles = roles;
 }
 
+bool SearchItemDelegate::uniformRowHeights() const
+{
+    return m_uniformRowHeights;
+}
+
+/*!
+  When \a enabled, sizeHint() returns the same height for all items without measuring them.
+  This should only be used together with QTreeView::uniformRowHeights, or a view that does not
+  need item widths, so that layout cost does not depend on the number of items.
+*/
+void SearchItemDelegate::setUniformRowHeights(bool enabled)
+{
+    m_uniformRowHeights = enabled;
+    m_rowHeight = -1;
+}
+
 bool SearchItemDelegate::helpEvent(QHelpEvent *event, QAbstractItemView *view,
                                    const QStyleOptionViewItem &option, const QModelIndex &index)
 {
     if (event->type() != QEvent::ToolTip)
         return QStyledItemDelegate::helpEvent(event, view, option, index);
 
-    if (sizeHint(option, index).width() < view->visualRect(index).width()) {
+    if (itemWidth(option, index) < view->visualRect(index).width()) {
         QToolTip::hideText();
         return QStyledItemDelegate::helpEvent(event, view, option, index);
     }
@@ -120,9 +145,12 @@ void SearchItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
     const QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, opt.widget)
             .adjusted(margin, 0, -margin, 0);
     const QFontMetrics &fm = opt.fontMetrics;
-    const QString elidedText = fm.elidedText(opt.text, opt.textElideMode, textRect.width());
+    const auto matchSpans = index.data(Registry::ItemDataRole::MatchSpansRole)
+            .value<QVector<QPair<int, int>>>();
+    const TextLayout *layout = textLayout(opt, matchSpans, textRect.width());
+    const QString elidedText = layout->elidedText;
 
-    if (!m_highlight.isEmpty()) {
+    if (!layout->highlightRanges.isEmpty()) {
         painter->save();
         painter->setRenderHint(QPainter::Antialiasing);
         painter->setPen(QColor::fromRgb(255, 253, 0));
@@ -131,22 +159,15 @@ void SearchItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
                 = (opt.state & (QStyle::State_Selected | QStyle::State_HasFocus))
                 ? QColor::fromRgb(255, 255, 100, 20) : QColor::fromRgb(255, 255, 100, 120);
 
-        for (int i = 0;;) {
-            const int matchIndex = opt.text.indexOf(m_highlight, i, Qt::CaseInsensitive);
-            if (matchIndex == -1 || matchIndex >= elidedText.length() - 1)
-                break;
-
-            QRect highlightRect
-                    = textRect.adjusted(fm.width(elidedText.left(matchIndex)), 2, 0, -2);
-            highlightRect.setWidth(fm.width(elidedText.mid(matchIndex, m_highlight.length())));
+        for (const QPair<int, int> &range : layout->highlightRanges) {
+            QRect highlightRect = textRect.adjusted(range.first, 2, 0, -2);
+            highlightRect.setWidth(range.second);
 
             QPainterPath path;
             path.addRoundedRect(highlightRect, 2, 2);
 
             painter->fillPath(path, highlightColor);
             painter->drawPath(path);
-
-            i = matchIndex + m_highlight.length();
         }
 
         painter->restore();
@@ -179,13 +200,33 @@ void SearchItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &op
 
 QSize SearchItemDelegate::sizeHint(const QStyleOptionViewItem &option,
                                    const QModelIndex &index) const
+{
+    if (m_uniformRowHeights) {
+        updateCacheFont(option.font);
+
+        if (m_rowHeight == -1)
+            m_rowHeight = QStyledItemDelegate::sizeHint(option, index).height();
+
+        return QSize(0, m_rowHeight);
+    }
+
+    QSize size = QStyledItemDelegate::sizeHint(option, index);
+    size.setWidth(itemWidth(option, index));
+    return size;
+}
+
+/*!
+  \internal
+  Returns width required to display decorations and full text of the \a index item.
+*/
+int SearchItemDelegate::itemWidth(const QStyleOptionViewItem &option,
+                                  const QModelIndex &index) const
 {
     QStyleOptionViewItem opt(option);
 
     QStyle *style = opt.widget->style();
 
-    QSize size = QStyledItemDelegate::sizeHint(opt, index);
-    size.setWidth(0);
+    int width = 0;
 
     const int margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, &opt, opt.widget) + 1;
 
@@ -200,14 +241,75 @@ QSize SearchItemDelegate::sizeHint(const QStyleOptionViewItem &option,
         const QIcon icon = index.data(roles.first()).value<QIcon>();
         const QSize actualSize = icon.actualSize(opt.decorationSize);
         const int decorationWidth = std::min(opt.decorationSize.width(), actualSize.width());
-        size.rwidth() = (decorationWidth + margin) * roles.size() + margin;
+        width = (decorationWidth + margin) * roles.size() + margin;
     }
 
-    size.rwidth() += opt.fontMetrics.width(index.data().toString()) + margin * 2;
-    return size;
+    return width + textWidth(opt, index.data().toString()) + margin * 2;
 }
 
-void SearchItemDelegate::setHighlight(const QString &text)
+/*!
+  \internal
+  Returns cached elided text and highlight geometry for the \a option text fitting into \a width.
+  \a matchSpans are (start, length) pairs of matched characters, as reported by the search.
+*/
+const SearchItemDelegate::TextLayout *SearchItemDelegate::textLayout(
+        const QStyleOptionViewItem &option, const QVector<QPair<int, int>> &matchSpans,
+        int width) const
 {
-    m_highlight = text;
+    updateCacheFont(option.font);
+
+    QString key = QString::number(width) + QLatin1Char('|');
+    for (const QPair<int, int> &span : matchSpans) {
+        key += QString::number(span.first) + QLatin1Char(',')
+                + QString::number(span.second) + QLatin1Char(';');
+    }
+    key += QLatin1Char('|') + option.text;
+
+    TextLayout *layout = m_textLayoutCache.object(key);
+    if (layout)
+        return layout;
+
+    const QFontMetrics &fm = option.fontMetrics;
+
+    layout = new TextLayout();
+    layout->elidedText = fm.elidedText(option.text, option.textElideMode, width);
+
+    for (const QPair<int, int> &span : matchSpans) {
+        // Skip spans hidden by elision.
+        if (span.first >= layout->elidedText.length() - 1)
+            break;
+
+        layout->highlightRanges.append({
+            fm.width(layout->elidedText.left(span.first)),
+            fm.width(layout->elidedText.mid(span.first, span.second))
+        });
+    }
+
+    m_textLayoutCache.insert(key, layout);
+    return layout;
+}
+
+int SearchItemDelegate::textWidth(const QStyleOptionViewItem &option, const QString &text) const
+{
+    updateCacheFont(option.font);
+
+    const int *width = m_textWidthCache.object(text);
+    if (width)
+        return *width;
+
+    const int value = option.fontMetrics.width(text);
+    m_textWidthCache.insert(text, new int(value));
+    return value;
+}
+
+// Cached geometry is only valid for the font it has been measured with.
+void SearchItemDelegate::updateCacheFont(const QFont &font) const
+{
+    if (font == m_cacheFont)
+        return;
+
+    m_cacheFont = font;
+    m_rowHeight = -1;
+    m_textLayoutCache.clear();
+    m_textWidthCache.clear();
 }
@@ -24,6 +24,7 @@
 #ifndef ZEAL_WIDGETUI_SEARCHITEMDELEGATE_H
 #define ZEAL_WIDGETUI_SEARCHITEMDELEGATE_H
 
+#include <QCache>
 #include <QStyledItemDelegate>
 
 namespace Zeal {
@@ -38,18 +39,36 @@ public:
     QList<int> decorationRoles() const;
     void setDecorationRoles(const QList<int> &roles);
 
+    bool uniformRowHeights() const;
+    void setUniformRowHeights(bool enabled);
+
     bool helpEvent(QHelpEvent *event, QAbstractItemView *view, const QStyleOptionViewItem &option,
                    const QModelIndex &index) override;
     void paint(QPainter *painter, const QStyleOptionViewItem &option,
                const QModelIndex &index) const override;
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
 
-public slots:
-    void setHighlight(const QString &text);
-
 private:
+    // Elided text and highlight geometry for a given text and available width.
+    struct TextLayout {
+        QString elidedText;
+        // Horizontal offset and width of each highlighted match relative to the text rectangle.
+        QVector<QPair<int, int>> highlightRanges;
+    };
+
+    const TextLayout *textLayout(const QStyleOptionViewItem &option,
+                                 const QVector<QPair<int, int>> &matchSpans, int width) const;
+    int itemWidth(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+    int textWidth(const QStyleOptionViewItem &option, const QString &text) const;
+    void updateCacheFont(const QFont &font) const;
+
     QList<int> m_decorationRoles = {Qt::DecorationRole};
-    QString m_highlight;
+    bool m_uniformRowHeights = false;
+
+    mutable QFont m_cacheFont;
+    mutable int m_rowHeight = -1;
+    mutable QCache<QString, TextLayout> m_textLayoutCache;
+    mutable QCache<QString, int> m_textWidthCache;
 };
 
 } // namespace WidgetUi
@@ -98,9 +98,14 @@ void SettingsDialog::loadSettings()
     ui->toolButton->setKeySequence(settings->showShortcut);
 
     ui->docsetStorageEdit->setText(QDir::toNativeSeparators(settings->docsetPath));
+    ui->maxConcurrentDownloadsSpinBox->setValue(settings->maxConcurrentDownloads);
+    ui->deduplicateDocsetFilesCheckBox->setChecked(settings->deduplicateDocsetFiles);
+    ui->packDocsetDocumentsCheckBox->setChecked(settings->packDocsetDocuments);
 
     // Tabs Tab
     ui->openNewTabAfterActive->setChecked(settings->openNewTabAfterActive);
+    ui->maxLoadedTabsSpinBox->setValue(settings->maxLoadedTabs);
+    ui->tabUnloadTimeoutSpinBox->setValue(settings->tabUnloadTimeout);
 
     // Search Tab
     ui->fuzzySearchCheckBox->setChecked(settings->fuzzySearchEnabled);
@@ -147,9 +152,14 @@ void SettingsDialog::saveSettings()
     settings->showShortcut = ui->toolButton->keySequence();
 
     settings->docsetPath = QDir::fromNativeSeparators(ui->docsetStorageEdit->text());
+    settings->maxConcurrentDownloads = ui->maxConcurrentDownloadsSpinBox->value();
+    settings->deduplicateDocsetFiles = ui->deduplicateDocsetFilesCheckBox->isChecked();
+    settings->packDocsetDocuments = ui->packDocsetDocumentsCheckBox->isChecked();
 
     // Tabs Tab
     settings->openNewTabAfterActive = ui->openNewTabAfterActive->isChecked();
+    settings->maxLoadedTabs = ui->maxLoadedTabsSpinBox->value();
+    settings->tabUnloadTimeout = ui->tabUnloadTimeoutSpinBox->value();
 
     // Search Tab
     settings->fuzzySearchEnabled = ui->fuzzySearchCheckBox->isChecked();
@@ -25,6 +25,8 @@
 
 #include "webview.h"
 
+#include <util/packfile.h>
+
 #include <QCoreApplication>
 #include <QLineEdit>
 #include <QStyle>
@@ -51,6 +53,7 @@ SearchableWebView::SearchableWebView(QWidget *parent) :
         moveLineEdit();
     });
 
+    connect(m_webView, &QWebView::loadFinished, this, &SearchableWebView::loadFinished);
     connect(m_webView, &QWebView::urlChanged, this, &SearchableWebView::urlChanged);
     connect(m_webView, &QWebView::titleChanged, this, &SearchableWebView::titleChanged);
     connect(m_webView, &QWebView::linkClicked, this, &SearchableWebView::linkClicked);
@@ -61,8 +64,10 @@ void SearchableWebView::setPage(QWebPage *page)
     m_webView->setPage(page);
 
     connect(page, &QWebPage::linkHovered, [&](const QString &link) {
-        if (link.startsWith(QLatin1String("file:")) || link.startsWith(QLatin1String("qrc:")))
+        if (link.startsWith(QLatin1String("file:")) || link.startsWith(QLatin1String("qrc:"))
+                || link.startsWith(Util::PackFile::urlScheme() + QLatin1Char(':'))) {
             return;
+        }
 
         setToolTip(link);
     });
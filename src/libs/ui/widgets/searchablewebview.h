@@ -56,6 +56,7 @@ public:
 signals:
     void urlChanged(const QUrl &url);
     void titleChanged(const QString &title);
+    void loadFinished(bool ok);
     void linkClicked(const QUrl &url);
 
 public slots:
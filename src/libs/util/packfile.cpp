@@ -0,0 +1,265 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "packfile.h"
+
+#include <QCache>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QWeakPointer>
+
+using namespace Zeal::Util;
+
+namespace {
+// Decompressed blocks shared by all packs, in bytes.
+const int BlockCacheSize = 32 * 1024 * 1024;
+
+QMutex &blockCacheMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QCache<quint64, QByteArray> &blockCache()
+{
+    static QCache<quint64, QByteArray> cache(BlockCacheSize);
+    return cache;
+}
+}
+
+/*!
+  \class Zeal::Util::PackFile
+  Provides read access to a pack, a single file replacing a directory tree. File contents are
+  concatenated and compressed in blocks of 64 KB, so that reading a file only decompresses the
+  blocks it spans. Recently used blocks are kept decompressed in memory.
+
+  The pack consists of a header, compressed blocks, an index and a footer:
+
+  \list
+    \li Header: magic \c ZPCK and format version, both \c quint32.
+    \li Blocks: each compressed with qCompress().
+    \li Index, serialized with QDataStream::Qt_5_6: block size as \c quint32, file offsets of
+        all blocks followed by the index offset as \c QVector<qint64>, number of entries as
+        \c quint32, and entries as path, offset and size in the uncompressed data.
+    \li Footer: index offset as \c qint64, and magic as \c quint32.
+  \endlist
+
+  \sa PackWriter
+*/
+PackFile::PackFile(const QString &filePath) :
+    m_filePath(filePath)
+{
+}
+
+PackFile::~PackFile()
+{
+    // Blocks of the pack cannot be requested anymore.
+    QMutexLocker locker(&blockCacheMutex());
+    for (int i = 0; i < m_blockOffsets.size() - 1; ++i)
+        blockCache().remove(m_id << 32 | static_cast<quint64>(i));
+}
+
+/*!
+  Returns the pack at \a filePath, or a null pointer if it cannot be read. Packs are shared until
+  the file changes.
+*/
+QSharedPointer<PackFile> PackFile::open(const QString &filePath)
+{
+    static QMutex mutex;
+    static QHash<QString, QWeakPointer<PackFile>> packs;
+    static quint64 lastId = 0;
+
+    const QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile())
+        return QSharedPointer<PackFile>();
+
+    const QString key = QDir::cleanPath(fileInfo.absoluteFilePath());
+
+    QMutexLocker locker(&mutex);
+
+    QSharedPointer<PackFile> pack = packs.value(key).toStrongRef();
+    if (pack && pack->m_lastModified == fileInfo.lastModified() && pack->m_size == fileInfo.size())
+        return pack;
+
+    pack.reset(new PackFile(key));
+    pack->m_lastModified = fileInfo.lastModified();
+    pack->m_size = fileInfo.size();
+    pack->m_id = ++lastId;
+
+    if (!pack->load())
+        return QSharedPointer<PackFile>();
+
+    for (auto it = packs.begin(); it != packs.end();) {
+        if (it.value().isNull())
+            it = packs.erase(it);
+        else
+            ++it;
+    }
+
+    packs.insert(key, pack);
+    return pack;
+}
+
+/*!
+  Returns path of the pack replacing directory at \a directoryPath.
+*/
+QString PackFile::packPath(const QString &directoryPath)
+{
+    return QDir::cleanPath(directoryPath) + QLatin1String(".pack");
+}
+
+/*!
+  Returns URL scheme of files inside of packs. URLs have the same path as the files would have in
+  the unpacked directory.
+*/
+QString PackFile::urlScheme()
+{
+    return QStringLiteral("zeal-pack");
+}
+
+QString PackFile::filePath() const
+{
+    return m_filePath;
+}
+
+bool PackFile::contains(const QString &path) const
+{
+    return m_entries.contains(path);
+}
+
+/*!
+  Returns contents of the file at \a path relative to the packed directory. If \a ok is not null,
+  it is set to \c false when there is no such file, or the pack is corrupted.
+*/
+QByteArray PackFile::read(const QString &path, bool *ok) const
+{
+    if (ok)
+        *ok = false;
+
+    const auto it = m_entries.constFind(path);
+    if (it == m_entries.cend())
+        return QByteArray();
+
+    QByteArray data;
+    data.reserve(static_cast<int>(it->size));
+
+    qint64 offset = it->offset;
+    qint64 remaining = it->size;
+    while (remaining > 0) {
+        const QByteArray blockData = block(static_cast<int>(offset / BlockSize));
+        const int blockOffset = static_cast<int>(offset % BlockSize);
+        if (blockData.size() <= blockOffset)
+            return QByteArray();
+
+        const int length = static_cast<int>(qMin<qint64>(remaining,
+                                                         blockData.size() - blockOffset));
+        data.append(blockData.constData() + blockOffset, length);
+
+        offset += length;
+        remaining -= length;
+    }
+
+    if (ok)
+        *ok = true;
+
+    return data;
+}
+
+bool PackFile::load()
+{
+    m_file.setFileName(m_filePath);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 footerSize = sizeof(qint64) + sizeof(quint32);
+    const qint64 headerSize = 2 * sizeof(quint32);
+    if (m_file.size() < headerSize + footerSize)
+        return false;
+
+    QDataStream stream(&m_file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != Magic || version != FormatVersion)
+        return false;
+
+    qint64 indexOffset;
+    m_file.seek(m_file.size() - footerSize);
+    stream >> indexOffset >> magic;
+    if (magic != Magic || indexOffset < headerSize || indexOffset > m_file.size() - footerSize)
+        return false;
+
+    m_file.seek(indexOffset);
+
+    quint32 blockSize;
+    quint32 entryCount;
+    stream >> blockSize >> m_blockOffsets >> entryCount;
+    if (blockSize != BlockSize || m_blockOffsets.isEmpty() || m_blockOffsets.last() != indexOffset)
+        return false;
+
+    const qint64 dataSize = static_cast<qint64>(m_blockOffsets.size() - 1) * BlockSize;
+
+    m_entries.reserve(static_cast<int>(entryCount));
+    for (quint32 i = 0; i < entryCount && stream.status() == QDataStream::Ok; ++i) {
+        QString path;
+        Entry entry;
+        stream >> path >> entry.offset >> entry.size;
+
+        if (entry.offset < 0 || entry.size < 0 || entry.offset + entry.size > dataSize)
+            return false;
+
+        m_entries.insert(path, entry);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+QByteArray PackFile::block(int index) const
+{
+    if (index < 0 || index >= m_blockOffsets.size() - 1)
+        return QByteArray();
+
+    const quint64 key = m_id << 32 | static_cast<quint64>(index);
+
+    {
+        QMutexLocker locker(&blockCacheMutex());
+        if (const QByteArray *data = blockCache().object(key))
+            return *data;
+    }
+
+    QByteArray compressedData;
+    {
+        QMutexLocker locker(&m_fileMutex);
+        if (m_file.seek(m_blockOffsets[index]))
+            compressedData = m_file.read(m_blockOffsets[index + 1] - m_blockOffsets[index]);
+    }
+
+    const QByteArray data = qUncompress(compressedData);
+
+    QMutexLocker locker(&blockCacheMutex());
+    blockCache().insert(key, new QByteArray(data), data.size());
+    return data;
+}
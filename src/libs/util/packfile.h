@@ -0,0 +1,83 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_UTIL_PACKFILE_H
+#define ZEAL_UTIL_PACKFILE_H
+
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
+namespace Zeal {
+namespace Util {
+
+class PackFile
+{
+public:
+    ~PackFile();
+
+    static QSharedPointer<PackFile> open(const QString &filePath);
+    static QString packPath(const QString &directoryPath);
+    static QString urlScheme();
+
+    QString filePath() const;
+
+    bool contains(const QString &path) const;
+    QByteArray read(const QString &path, bool *ok = nullptr) const;
+
+private:
+    friend class PackWriter;
+
+    struct Entry
+    {
+        qint64 offset;
+        qint64 size;
+    };
+
+    static const quint32 Magic = 0x5a50434b; // "ZPCK"
+    static const quint32 FormatVersion = 1;
+    static const int BlockSize = 64 * 1024;
+
+    explicit PackFile(const QString &filePath);
+
+    bool load();
+    QByteArray block(int index) const;
+
+    QString m_filePath;
+    QDateTime m_lastModified;
+    qint64 m_size = 0;
+    quint64 m_id = 0;
+
+    QVector<qint64> m_blockOffsets; // Blocks end where the next one or the index starts.
+    QHash<QString, Entry> m_entries;
+
+    mutable QFile m_file;
+    mutable QMutex m_fileMutex;
+};
+
+} // namespace Util
+} // namespace Zeal
+
+#endif // ZEAL_UTIL_PACKFILE_H
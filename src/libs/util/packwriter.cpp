@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#include "packwriter.h"
+
+#include "packfile.h"
+
+using namespace Zeal::Util;
+
+/*!
+  \class Zeal::Util::PackWriter
+  Writes a pack readable by PackFile. Files are compressed as they are added, and the index is
+  written when the pack is closed. A pack that has not been closed is invalid.
+*/
+PackWriter::PackWriter(const QString &filePath) :
+    m_file(filePath)
+{
+    m_stream.setVersion(QDataStream::Qt_5_6);
+}
+
+PackWriter::~PackWriter()
+{
+    m_file.close();
+}
+
+bool PackWriter::open()
+{
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream << PackFile::Magic << PackFile::FormatVersion;
+    return true;
+}
+
+/*!
+  Adds file at \a path, relative to the packed directory, with \a data.
+*/
+bool PackWriter::add(const QString &path, const QByteArray &data)
+{
+    if (!m_entries.contains(path))
+        m_paths.append(path);
+    m_entries.insert(path, {m_dataSize, data.size()});
+    m_dataSize += data.size();
+
+    const int blockSize = PackFile::BlockSize;
+
+    int offset = 0;
+    while (offset < data.size()) {
+        const int length = qMin(data.size() - offset, blockSize - m_buffer.size());
+        m_buffer.append(data.constData() + offset, length);
+        offset += length;
+
+        if (m_buffer.size() == blockSize) {
+            if (!writeBlock(m_buffer))
+                return false;
+            m_buffer.clear();
+        }
+    }
+
+    return true;
+}
+
+/*!
+  Adds file at \a path sharing contents of already added \a targetPath. Returns \c false if
+  there is no such file.
+*/
+bool PackWriter::addLink(const QString &path, const QString &targetPath)
+{
+    const auto it = m_entries.constFind(targetPath);
+    if (it == m_entries.cend())
+        return false;
+
+    const Entry entry = it.value();
+    if (!m_entries.contains(path))
+        m_paths.append(path);
+    m_entries.insert(path, entry);
+    return true;
+}
+
+/*!
+  Writes the remaining data and the index.
+*/
+bool PackWriter::close()
+{
+    if (!m_buffer.isEmpty()) {
+        if (!writeBlock(m_buffer))
+            return false;
+        m_buffer.clear();
+    }
+
+    const qint64 indexOffset = m_file.pos();
+    m_blockOffsets.append(indexOffset);
+
+    m_stream << static_cast<quint32>(PackFile::BlockSize) << m_blockOffsets
+             << static_cast<quint32>(m_paths.size());
+    for (const QString &path : m_paths) {
+        const Entry entry = m_entries.value(path);
+        m_stream << path << entry.offset << entry.size;
+    }
+
+    m_stream << indexOffset << PackFile::Magic;
+
+    if (m_stream.status() != QDataStream::Ok || !m_file.flush()) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_file.close();
+    return true;
+}
+
+QString PackWriter::errorString() const
+{
+    return m_errorString;
+}
+
+bool PackWriter::writeBlock(const QByteArray &data)
+{
+    m_blockOffsets.append(m_file.pos());
+
+    const QByteArray compressedData = qCompress(data);
+    if (m_file.write(compressedData) != compressedData.size()) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2015-2016 Oleg Shparber
+** Contact: https://go.zealdocs.org/l/contact
+**
+** This file is part of Zeal.
+**
+** Zeal is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** Zeal is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with Zeal. If not, see <https://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+#ifndef ZEAL_UTIL_PACKWRITER_H
+#define ZEAL_UTIL_PACKWRITER_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+namespace Zeal {
+namespace Util {
+
+class PackWriter
+{
+public:
+    explicit PackWriter(const QString &filePath);
+    ~PackWriter();
+
+    bool open();
+    bool add(const QString &path, const QByteArray &data);
+    bool addLink(const QString &path, const QString &targetPath);
+    bool close();
+
+    QString errorString() const;
+
+private:
+    struct Entry
+    {
+        qint64 offset;
+        qint64 size;
+    };
+
+    bool writeBlock(const QByteArray &data);
+
+    QFile m_file;
+    QDataStream m_stream;
+
+    QByteArray m_buffer; // Data of the block being filled.
+    qint64 m_dataSize = 0;
+    QVector<qint64> m_blockOffsets;
+    QHash<QString, Entry> m_entries;
+    QStringList m_paths; // In the order of addition.
+
+    QString m_errorString;
+};
+
+} // namespace Util
+} // namespace Zeal
+
+#endif // ZEAL_UTIL_PACKWRITER_H